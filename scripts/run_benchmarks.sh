@@ -0,0 +1,45 @@
+#!/bin/bash
+# Run the benchmark matrix: every mesh of the 2D and 3D benchmarks, with every
+# block preconditioner, on several numbers of MPI processes and of threads.
+# Each case runs a few time steps and appends one line to the report.
+#
+# Usage (from the build directory):
+#   ../scripts/run_benchmarks.sh [report file]
+# The matrix can be restricted through the environment variables RANKS,
+# THREADS, PRECONDITIONERS, CASES and STEPS, e.g.
+#   RANKS="1 4" CASES="2:cilinder_2D_coarse" ../scripts/run_benchmarks.sh
+
+REPORT=${1:-benchmark_report.csv}
+BENCH=${BENCH:-./navier_stokes_bench}
+MESH_DIR=${MESH_DIR:-$(dirname "$0")/../mesh}
+MPIRUN=${MPIRUN:-mpirun}
+
+RANKS=${RANKS:-"1 2 4"}
+THREADS=${THREADS:-"1 2"}
+STEPS=${STEPS:-5}
+PRECONDITIONERS=${PRECONDITIONERS:-"BlockDiagonal BlockTriangular SIMPLE aSIMPLE PCD LSC"}
+CASES=${CASES:-"2:cilinder_2D_coarse 2:cilinder_2D_fine 2:cilinder_2D_fine_fine \
+3:cilinder_3D_coarse_coarse 3:cilinder_3D_coarse 3:cilinder_3D_fine"}
+
+rm -f "$REPORT"
+
+for case in $CASES; do
+  dim=${case%%:*}
+  mesh=${case#*:}
+  for preconditioner in $PRECONDITIONERS; do
+    for ranks in $RANKS; do
+      for threads in $THREADS; do
+        echo "== ${dim}D ${mesh}, ${preconditioner}, ${ranks} rank(s) x ${threads} thread(s)"
+        "$MPIRUN" -n "$ranks" "$BENCH" "$dim" \
+          "Mesh file=${MESH_DIR}/${mesh}.msh" \
+          "Threads=${threads}" \
+          "Linear solver/Preconditioner=${preconditioner}" \
+          "Benchmark/Steps=${STEPS}" \
+          "Benchmark/Report file=${REPORT}" > /dev/null ||
+          echo "   failed"
+      done
+    done
+  done
+done
+
+echo "Report written to ${REPORT}"
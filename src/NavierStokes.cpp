@@ -0,0 +1,2952 @@
+#include "NavierStokes.hpp"
+
+template <int dim>
+NavierStokes<dim>::NavierStokes(ParameterHandler &prm)
+    : NavierStokes(prm.get("Mesh file"),
+                   prm.get_integer("Velocity degree"),
+                   prm.get_integer("Pressure degree"),
+                   prm.get_double("Final time"),
+                   prm.get_double("Time step"),
+                   prm.get_bool("Matrix free"))
+{
+  parse_parameters(prm);
+}
+
+template <int dim>
+void NavierStokes<dim>::declare_parameters(ParameterHandler &prm)
+{
+  prm.declare_entry("Mesh file",
+                    dim == 2 ? "../mesh/cilinder_2D_fine.msh"
+                             : "../mesh/cilinder_3D_coarse.msh",
+                    Patterns::FileName(),
+                    "Gmsh mesh of the benchmark geometry");
+  prm.declare_entry("Velocity degree", "2", Patterns::Integer(1));
+  prm.declare_entry("Pressure degree", "1", Patterns::Integer(1));
+  prm.declare_entry("Final time", dim == 2 ? "24" : "8", Patterns::Double(0.0));
+  prm.declare_entry("Time step", "0.05", Patterns::Double(0.0),
+                    "Initial time step if adaptive time stepping is enabled");
+  prm.declare_entry("Threads", "1", Patterns::Integer(1),
+                    "Number of threads of each MPI process during assembly");
+  prm.declare_entry("Matrix free", "false", Patterns::Bool(),
+                    "Do not store the velocity-velocity block");
+
+  prm.enter_subsection("Physics");
+  {
+    prm.declare_entry("Viscosity", "1e-3", Patterns::Double(0.0));
+    prm.declare_entry("Maximum inlet velocity",
+                      dim == 2 ? "15" : "2.25",
+                      Patterns::Double(0.0));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Linear solver");
+  {
+    prm.declare_entry("Tolerance",
+                      dim == 2 ? "1e-4" : "1e-2",
+                      Patterns::Double(0.0),
+                      "Outer solver tolerance, relative to the norm of the "
+                      "right-hand side");
+    prm.declare_entry("Restart length", "30", Patterns::Integer(1));
+    prm.declare_entry("Initial guess",
+                      "Previous",
+                      Patterns::Selection("Previous|Linear|Quadratic|Projection"),
+                      "Initial guess of the outer solver, computed from the "
+                      "solutions of the last time steps");
+    prm.declare_entry("Projection vectors", "5", Patterns::Integer(1),
+                      "Number of solutions combined by the Projection guess");
+    prm.declare_entry("Outer solver",
+                      "FGMRES",
+                      Patterns::Selection("GMRES|FGMRES"),
+                      "FGMRES allows for the inexact inner solves of the "
+                      "preconditioner");
+    prm.declare_entry("Preconditioner",
+                      "aSIMPLE",
+                      Patterns::Selection("BlockDiagonal|BlockTriangular|SIMPLE|aSIMPLE|PCD|LSC"),
+                      "Ignored in matrix-free mode, which always uses aSIMPLE");
+    prm.declare_entry("Inner preconditioner",
+                      "ILU",
+                      Patterns::Selection("ILU|AMG"));
+    prm.declare_entry("Inner tolerance", "1e-2", Patterns::Double(0.0),
+                      "Relative tolerance of the inner solves of the preconditioner");
+    prm.declare_entry("Inner solve",
+                      "Tolerance",
+                      Patterns::Selection("Tolerance|Adaptive|Iterations|Application"),
+                      "How the inner solves are stopped: at the inner tolerance, "
+                      "at a tolerance relaxed as the outer residual decreases, "
+                      "after a fixed number of iterations, or replaced by a "
+                      "single application of the inner preconditioner");
+    prm.declare_entry("Inner iterations", "5", Patterns::Integer(1),
+                      "Number of iterations of the inner solves (Iterations only)");
+    prm.declare_entry("Maximum inner tolerance", "0.1", Patterns::Double(0.0),
+                      "Largest relaxed inner tolerance (Adaptive only, which "
+                      "requires FGMRES)");
+    prm.declare_entry("Preconditioner max age", "1", Patterns::Integer(1),
+                      "Number of time steps the preconditioner is reused for");
+    prm.declare_entry("Preconditioner max iterations", "0", Patterns::Integer(0),
+                      "Rebuild the preconditioner after a solve with more outer "
+                      "iterations than this (0 to disable)");
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Assembly");
+  {
+    prm.declare_entry("Engine", "CellWise", Patterns::Selection("CellWise|Batched"));
+    prm.declare_entry("Dirichlet method",
+                      "ApplyBoundaryValues",
+                      Patterns::Selection("ApplyBoundaryValues|Constraints"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Mesh partitioning");
+  {
+    prm.declare_entry("Group size", "0", Patterns::Integer(0),
+                      "Number of processes of each group sharing a reader of the "
+                      "mesh (0 for a single group)");
+    prm.declare_entry("Partition file prefix", "", Patterns::Anything(),
+                      "Save the partitioned mesh to (and read it from) files with "
+                      "this prefix (empty to disable)");
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Output");
+  {
+    prm.declare_entry("Format", "VTU", Patterns::Selection("VTU|HDF5"));
+    prm.declare_entry("Interval steps", "1", Patterns::Integer(1));
+    prm.declare_entry("Interval time", "0", Patterns::Double(0.0),
+                      "If positive, write the solution at this interval of "
+                      "simulated time instead");
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Checkpoint");
+  {
+    prm.declare_entry("Interval", "0", Patterns::Double(0.0),
+                      "Wall time in seconds between two checkpoints (0 to disable)");
+    prm.declare_entry("Prefix", "checkpoint", Patterns::Anything());
+    prm.declare_entry("Restart", "false", Patterns::Bool());
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Time stepping");
+  {
+    prm.declare_entry("Target CFL", "0", Patterns::Double(0.0),
+                      "Target CFL number of adaptive time stepping (0 for a "
+                      "fixed time step)");
+    prm.declare_entry("Minimum time step", "0", Patterns::Double(0.0),
+                      "0 for a hundredth of the initial time step");
+    prm.declare_entry("Maximum time step", "0", Patterns::Double(0.0),
+                      "0 for ten times the initial time step");
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Forces");
+  {
+    prm.declare_entry("Method", "Surface", Patterns::Selection("Surface|Volume"));
+  }
+  prm.leave_subsection();
+}
+
+template <int dim>
+void NavierStokes<dim>::parse_command_line(ParameterHandler &prm,
+                                           const int argc,
+                                           char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string argument(argv[i]);
+    const std::size_t equal_sign = argument.find('=');
+
+    // An argument without "=" is the parameter file. It is read first, so
+    // that it is overridden by the other arguments wherever they are.
+    if (equal_sign == std::string::npos)
+    {
+      AssertThrow(i == 1,
+                  ExcMessage("The parameter file must be the first argument."));
+      prm.parse_input(argument);
+      continue;
+    }
+
+    // The name of an override is the path of the parameter, with subsections
+    // separated by "/".
+    std::vector<std::string> path =
+        Utilities::split_string_list(argument.substr(0, equal_sign), '/');
+    const std::string name = path.back();
+    path.pop_back();
+
+    for (const std::string &subsection : path)
+      prm.enter_subsection(subsection);
+    prm.set(name, argument.substr(equal_sign + 1));
+    for (unsigned int j = 0; j < path.size(); ++j)
+      prm.leave_subsection();
+  }
+}
+
+template <int dim>
+void NavierStokes<dim>::parse_parameters(ParameterHandler &prm)
+{
+  prm.enter_subsection("Physics");
+  {
+    set_physical_parameters(prm.get_double("Viscosity"),
+                            prm.get_double("Maximum inlet velocity"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Linear solver");
+  {
+    set_linear_solver(prm.get_double("Tolerance"),
+                      prm.get_integer("Restart length"),
+                      prm.get_double("Inner tolerance"));
+    set_outer_solver(prm.get("Outer solver") == "GMRES" ? OuterSolverType::GMRES
+                                                        : OuterSolverType::FGMRES);
+
+    const std::string initial_guess_name = prm.get("Initial guess");
+    set_initial_guess(initial_guess_name == "Linear" ? InitialGuessType::Linear
+                      : initial_guess_name == "Quadratic"
+                          ? InitialGuessType::Quadratic
+                      : initial_guess_name == "Projection"
+                          ? InitialGuessType::Projection
+                          : InitialGuessType::Previous,
+                      prm.get_integer("Projection vectors"));
+
+    const std::string preconditioner_name = prm.get("Preconditioner");
+    if (preconditioner_name == "BlockDiagonal")
+      set_preconditioner(PreconditionerType::BlockDiagonal);
+    else if (preconditioner_name == "BlockTriangular")
+      set_preconditioner(PreconditionerType::BlockTriangular);
+    else if (preconditioner_name == "SIMPLE")
+      set_preconditioner(PreconditionerType::SIMPLE);
+    else if (preconditioner_name == "PCD")
+      set_preconditioner(PreconditionerType::PCD);
+    else if (preconditioner_name == "LSC")
+      set_preconditioner(PreconditionerType::LSC);
+    else
+      set_preconditioner(PreconditionerType::aSIMPLE);
+
+    const std::string inner_solve_name = prm.get("Inner solve");
+    set_inner_solve(inner_solve_name == "Adaptive"     ? InnerSolveType::Adaptive
+                    : inner_solve_name == "Iterations" ? InnerSolveType::Iterations
+                    : inner_solve_name == "Application"
+                        ? InnerSolveType::Application
+                        : InnerSolveType::Tolerance,
+                    prm.get_integer("Inner iterations"),
+                    prm.get_double("Maximum inner tolerance"));
+
+    AssertThrow(inner_solve_type != InnerSolveType::Adaptive ||
+                    outer_solver_type == OuterSolverType::FGMRES,
+                ExcMessage("The Adaptive inner solve changes the preconditioner "
+                           "at each outer iteration, and requires FGMRES."));
+
+    set_inner_preconditioner(prm.get("Inner preconditioner") == "AMG"
+                                 ? InnerPreconditionerType::AMG
+                                 : InnerPreconditionerType::ILU);
+
+    const unsigned int max_iterations = prm.get_integer("Preconditioner max iterations");
+    set_preconditioner_refresh(max_iterations > 0 ? max_iterations
+                                                  : numbers::invalid_unsigned_int,
+                               prm.get_integer("Preconditioner max age"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Assembly");
+  {
+    set_assembly_engine(prm.get("Engine") == "Batched" ? AssemblyEngine::Batched
+                                                       : AssemblyEngine::CellWise);
+    set_dirichlet_method(prm.get("Dirichlet method") == "Constraints"
+                             ? DirichletMethod::Constraints
+                             : DirichletMethod::ApplyBoundaryValues);
+
+    AssertThrow(assembly_engine == AssemblyEngine::CellWise ||
+                    dirichlet_method == DirichletMethod::ApplyBoundaryValues,
+                ExcMessage("The batched engine does not support Dirichlet "
+                           "constraints, use the cell-wise one."));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Mesh partitioning");
+  {
+    set_mesh_partitioning(prm.get_integer("Group size"),
+                          prm.get("Partition file prefix"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Output");
+  {
+    set_output_format(prm.get("Format") == "HDF5" ? OutputFormat::HDF5
+                                                  : OutputFormat::VTU);
+    set_output_frequency(prm.get_integer("Interval steps"),
+                         prm.get_double("Interval time"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Checkpoint");
+  {
+    set_checkpointing(prm.get_double("Interval"),
+                      prm.get("Prefix"),
+                      prm.get_bool("Restart"));
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Time stepping");
+  {
+    const double target_cfl = prm.get_double("Target CFL");
+    const double dt_min = prm.get_double("Minimum time step");
+    const double dt_max = prm.get_double("Maximum time step");
+    if (target_cfl > 0.0)
+      set_adaptive_time_step(target_cfl,
+                             dt_min > 0.0 ? dt_min : deltat / 100.0,
+                             dt_max > 0.0 ? dt_max : 10.0 * deltat);
+  }
+  prm.leave_subsection();
+
+  prm.enter_subsection("Forces");
+  {
+    set_force_method(prm.get("Method") == "Volume" ? ForceMethod::Volume
+                                                   : ForceMethod::Surface);
+  }
+  prm.leave_subsection();
+}
+
+template <int dim>
+void NavierStokes<dim>::setup()
+{
+  Profiler::Scope setup_scope(profiler, "setup");
+
+  // Create the mesh.
+  {
+    Profiler::Scope scope(profiler, "mesh");
+
+    pcout << "Initializing the mesh" << std::endl;
+
+    // File storing the description of the part of the mesh owned by this
+    // process, if partitioned meshes are saved to disk. The number of
+    // processes is part of the name, since the partition depends on it.
+    const std::string partition_file_name =
+        partition_file_prefix + "." + std::to_string(mpi_size) + "." +
+        std::to_string(mpi_rank) + ".partition";
+
+    // The first line of a partition file identifies the mesh file it was
+    // created from, by name, size and modification time: partitions of
+    // another mesh, or of an older version of the same file, are not loaded
+    // but created again.
+    std::error_code error;
+    const std::string mesh_signature =
+        mesh_file_name + " " +
+        std::to_string(std::filesystem::file_size(mesh_file_name, error)) +
+        " " +
+        std::to_string(std::filesystem::last_write_time(mesh_file_name, error)
+                           .time_since_epoch()
+                           .count());
+
+    std::ifstream partition_file;
+    std::string partition_signature;
+    if (!partition_file_prefix.empty())
+    {
+      partition_file.open(partition_file_name, std::ios::binary);
+      std::getline(partition_file, partition_signature);
+    }
+
+    const bool load_partition =
+        !partition_file_prefix.empty() &&
+        Utilities::MPI::min(partition_file.good() &&
+                                    partition_signature == mesh_signature
+                                ? 1u
+                                : 0u,
+                            MPI_COMM_WORLD) == 1;
+
+    if (!partition_file_prefix.empty() && !load_partition &&
+        Utilities::MPI::max(partition_file.good() ? 1u : 0u, MPI_COMM_WORLD) ==
+            1)
+      pcout << "  The partition files " << partition_file_prefix
+            << " do not match " << mesh_file_name << ", partitioning again"
+            << std::endl;
+
+    TriangulationDescription::Description<dim, dim> construction_data;
+
+    if (load_partition)
+    {
+      pcout << "  Reading the partitioned mesh from " << partition_file_prefix
+            << std::endl;
+
+      const std::vector<char> buffer(
+          (std::istreambuf_iterator<char>(partition_file)),
+          std::istreambuf_iterator<char>());
+      construction_data = Utilities::unpack<
+          TriangulationDescription::Description<dim, dim>>(buffer, false);
+      construction_data.comm = MPI_COMM_WORLD;
+    }
+    else
+    {
+      // Only the first process of each group reads the mesh and partitions
+      // it; the others only receive the description of their own part, so
+      // that they never store the whole mesh.
+      construction_data = TriangulationDescription::Utilities::
+          create_description_from_triangulation_in_groups<dim, dim>(
+              [this](Triangulation<dim> &mesh_serial)
+              {
+                Profiler::Scope scope(profiler, "mesh read");
+
+                GridIn<dim> grid_in;
+                grid_in.attach_triangulation(mesh_serial);
+
+                std::ifstream grid_in_file(mesh_file_name);
+                grid_in.read_msh(grid_in_file);
+              },
+              [this](Triangulation<dim> &mesh_serial,
+                     const MPI_Comm comm,
+                     const unsigned int /*group_size*/)
+              {
+                Profiler::Scope scope(profiler, "partition");
+
+                GridTools::partition_triangulation(
+                    Utilities::MPI::n_mpi_processes(comm), mesh_serial);
+              },
+              MPI_COMM_WORLD,
+              mesh_group_size == 0 ? mpi_size : mesh_group_size);
+
+      if (!partition_file_prefix.empty())
+      {
+        pcout << "  Saving the partitioned mesh to " << partition_file_prefix
+              << std::endl;
+
+        const std::vector<char> buffer = Utilities::pack(construction_data,
+                                                         false);
+        partition_file.close();
+        std::ofstream output_file(partition_file_name, std::ios::binary);
+        output_file << mesh_signature << '\n';
+        output_file.write(buffer.data(), buffer.size());
+      }
+    }
+
+    mesh.create_triangulation(construction_data);
+
+    pcout << "  Number of elements = " << mesh.n_global_active_cells()
+          << std::endl;
+  }
+
+  pcout << "-----------------------------------------------" << std::endl;
+
+  // Initialize the finite element space.
+  {
+    pcout << "Initializing the finite element space" << std::endl;
+
+    const FE_SimplexP<dim> fe_scalar_velocity(degree_velocity);
+    const FE_SimplexP<dim> fe_scalar_pressure(degree_pressure);
+    fe = std::make_unique<FESystem<dim>>(fe_scalar_velocity,
+                                         dim,
+                                         fe_scalar_pressure,
+                                         1);
+
+    pcout << "  Velocity degree:           = " << fe_scalar_velocity.degree
+          << std::endl;
+    pcout << "  Pressure degree:           = " << fe_scalar_pressure.degree
+          << std::endl;
+    pcout << "  DoFs per cell              = " << fe->dofs_per_cell
+          << std::endl;
+
+    quadrature = std::make_unique<QGaussSimplex<dim>>(fe->degree + 1);
+
+    pcout << "  Quadrature points per cell = " << quadrature->size()
+          << std::endl;
+
+    quadrature_face = std::make_unique<QGaussSimplex<dim - 1>>(fe->degree + 1);
+
+    pcout << "  Quadrature points per face = " << quadrature_face->size()
+          << std::endl;
+  }
+
+  pcout << "-----------------------------------------------" << std::endl;
+
+  // Initialize the DoF handler.
+  {
+    Profiler::Scope scope(profiler, "dofs");
+
+    pcout << "Initializing the DoF handler" << std::endl;
+
+    dof_handler.reinit(mesh);
+    dof_handler.distribute_dofs(*fe);
+
+    // We want to reorder DoFs so that all velocity DoFs come first, and then
+    // all pressure DoFs.
+    std::vector<unsigned int> block_component(dim + 1, 0);
+    block_component[dim] = 1;
+    DoFRenumbering::component_wise(dof_handler, block_component);
+
+    // Locally owned cells, split into batches for the batched assembly.
+    locally_owned_cells.clear();
+    batch_starts.clear();
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+      {
+        if (locally_owned_cells.size() % n_lanes == 0)
+          batch_starts.push_back(locally_owned_cells.size());
+        locally_owned_cells.push_back(cell);
+      }
+
+    locally_owned_dofs = dof_handler.locally_owned_dofs();
+    DoFTools::extract_locally_relevant_dofs(dof_handler, locally_relevant_dofs);
+
+    // Besides the locally owned and locally relevant indices for the whole
+    // system (velocity and pressure), we will also need those for the
+    // individual velocity and pressure blocks.
+    std::vector<types::global_dof_index> dofs_per_block =
+        DoFTools::count_dofs_per_fe_block(dof_handler, block_component);
+    const unsigned int n_u = dofs_per_block[0];
+    const unsigned int n_p = dofs_per_block[1];
+
+    block_owned_dofs.resize(2);
+    block_relevant_dofs.resize(2);
+    block_owned_dofs[0] = locally_owned_dofs.get_view(0, n_u);
+    block_owned_dofs[1] = locally_owned_dofs.get_view(n_u, n_u + n_p);
+    block_relevant_dofs[0] = locally_relevant_dofs.get_view(0, n_u);
+    block_relevant_dofs[1] = locally_relevant_dofs.get_view(n_u, n_u + n_p);
+
+    // Constant modes of the velocity components, used by the AMG
+    // preconditioner of the velocity block.
+    const FEValuesExtractors::Vector velocity(0);
+    DoFTools::extract_constant_modes(dof_handler,
+                                     fe->component_mask(velocity),
+                                     velocity_constant_modes);
+
+    pcout << "  Number of DoFs: " << std::endl;
+    pcout << "    velocity = " << n_u << std::endl;
+    pcout << "    pressure = " << n_p << std::endl;
+    pcout << "    total    = " << n_u + n_p << std::endl;
+  }
+
+  pcout << "-----------------------------------------------" << std::endl;
+
+  // Initialize the linear system.
+  {
+    pcout << "Initializing the linear system" << std::endl;
+
+    pcout << "  Initializing the sparsity pattern" << std::endl;
+
+    profiler.enter("sparsity");
+
+    // Velocity DoFs interact with other velocity DoFs (the weak formulation has
+    // terms involving u times v), and pressure DoFs interact with velocity DoFs
+    // (there are terms involving p times v or u times q). However, pressure
+    // DoFs do not interact with other pressure DoFs (there are no terms
+    // involving p times q). We build a table to store this information, so that
+    // the sparsity pattern can be built accordingly.
+    Table<2, DoFTools::Coupling> coupling(dim + 1, dim + 1);
+    for (unsigned int c = 0; c < dim + 1; ++c)
+    {
+      for (unsigned int d = 0; d < dim + 1; ++d)
+      {
+        if (c == dim && d == dim) // pressure-pressure term
+          coupling[c][d] = DoFTools::none;
+        else if (matrix_free && c < dim && d < dim) // velocity-velocity term
+          coupling[c][d] = DoFTools::none;
+        else // other combinations
+          coupling[c][d] = DoFTools::always;
+      }
+    }
+
+    TrilinosWrappers::BlockSparsityPattern sparsity(block_owned_dofs,
+                                                    MPI_COMM_WORLD);
+    DoFTools::make_sparsity_pattern(dof_handler, coupling, sparsity);
+    sparsity.compress();
+
+    // We also build a sparsity pattern for the pressure mass matrix, if the
+    // preconditioner needs it.
+    if (pressure_mass_needed())
+    {
+      for (unsigned int c = 0; c < dim + 1; ++c)
+      {
+        for (unsigned int d = 0; d < dim + 1; ++d)
+        {
+          if (c == dim && d == dim) // pressure-pressure term
+            coupling[c][d] = DoFTools::always;
+          else // other combinations
+            coupling[c][d] = DoFTools::none;
+        }
+      }
+      TrilinosWrappers::BlockSparsityPattern sparsity_pressure_mass(
+          block_owned_dofs, MPI_COMM_WORLD);
+      DoFTools::make_sparsity_pattern(dof_handler,
+                                      coupling,
+                                      sparsity_pressure_mass);
+      sparsity_pressure_mass.compress();
+
+      pcout << "  Initializing the pressure mass matrix" << std::endl;
+      pressure_mass.reinit(sparsity_pressure_mass);
+
+      // The PCD matrices share the sparsity of the pressure mass matrix, and
+      // vanish on the outlet pressure DoFs.
+      if (!matrix_free && preconditioner_type == PreconditionerType::PCD)
+      {
+        pcout << "  Initializing the PCD matrices" << std::endl;
+        pressure_laplacian.reinit(sparsity_pressure_mass);
+        pressure_convection_diffusion.reinit(sparsity_pressure_mass);
+
+        const FEValuesExtractors::Scalar pressure(dim);
+        Functions::ZeroFunction<dim> zero_function(dim + 1);
+        std::map<types::boundary_id, const Function<dim> *> boundary_functions;
+        boundary_functions[outlet_id] = &zero_function;
+
+        pcd_constraints.clear();
+        pcd_constraints.reinit(locally_relevant_dofs);
+        VectorTools::interpolate_boundary_values(dof_handler,
+                                                 boundary_functions,
+                                                 pcd_constraints,
+                                                 fe->component_mask(pressure));
+        pcd_constraints.close();
+
+        // The pressure block is indexed from the first pressure DoF.
+        const types::global_dof_index first_pressure_dof =
+            block_owned_dofs[0].size();
+        pcd_free_pressure.reinit(block_owned_dofs[1], MPI_COMM_WORLD);
+        for (const types::global_dof_index i : block_owned_dofs[1])
+          pcd_free_pressure(i) =
+              pcd_constraints.is_constrained(i + first_pressure_dof) ? 0.0 : 1.0;
+        pcd_free_pressure.compress(VectorOperation::insert);
+      }
+    }
+
+    profiler.leave();
+
+    pcout << "  Initializing the matrices" << std::endl;
+    system_matrix.reinit(sparsity);
+    constant_matrix.reinit(sparsity);
+
+    pcout << "  Initializing the system right-hand side" << std::endl;
+    system_rhs.reinit(block_owned_dofs, MPI_COMM_WORLD);
+    pcout << "  Initializing the solution vector" << std::endl;
+    solution_owned.reinit(block_owned_dofs, MPI_COMM_WORLD);
+    solution.reinit(block_owned_dofs, block_relevant_dofs, MPI_COMM_WORLD);
+
+    if (matrix_free)
+    {
+      pcout << "  Initializing the matrix-free operator" << std::endl;
+      oseen_operator.initialize(dof_handler,
+                                *quadrature,
+                                system_matrix,
+                                block_owned_dofs[0],
+                                block_relevant_dofs[0],
+                                nu);
+    }
+
+    AssertThrow(!matrix_free ||
+                    dirichlet_method == DirichletMethod::ApplyBoundaryValues,
+                ExcMessage("Dirichlet constraints are not supported in "
+                           "matrix-free mode."));
+
+    {
+      Profiler::Scope scope(profiler, "boundary values");
+      setup_boundary_values();
+    }
+    {
+      Profiler::Scope scope(profiler, "force evaluation");
+      setup_force_evaluation();
+    }
+    {
+      Profiler::Scope scope(profiler, "constant matrices");
+      assemble_constant(pressure_mass_needed());
+      if (!matrix_free && preconditioner_type == PreconditionerType::LSC)
+        assemble_lumped_velocity_mass();
+    }
+  }
+}
+
+template <int dim>
+void NavierStokes<dim>::setup_force_evaluation()
+{
+  obstacle_faces.clear();
+  for (const auto &cell : dof_handler.active_cell_iterators())
+  {
+    if (!cell->is_locally_owned() || !cell->at_boundary())
+      continue;
+
+    for (unsigned int f = 0; f < cell->n_faces(); ++f)
+      if (cell->face(f)->at_boundary() &&
+          std::find(obstacle_ids.begin(),
+                    obstacle_ids.end(),
+                    cell->face(f)->boundary_id()) != obstacle_ids.end())
+        obstacle_faces.emplace_back(cell, f);
+  }
+
+  obstacle_cells.clear();
+  if (force_method == ForceMethod::Volume)
+  {
+    // Velocity DoFs on the obstacle faces of the locally owned and ghost
+    // cells, so that those of owned cells touching the obstacle only by a
+    // vertex or an edge are found too.
+    std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+
+    obstacle_dofs = IndexSet(dof_handler.n_dofs());
+    for (const auto &cell : dof_handler.active_cell_iterators())
+    {
+      if (cell->is_artificial() || !cell->at_boundary())
+        continue;
+
+      for (unsigned int f = 0; f < cell->n_faces(); ++f)
+      {
+        if (!cell->face(f)->at_boundary() ||
+            std::find(obstacle_ids.begin(),
+                      obstacle_ids.end(),
+                      cell->face(f)->boundary_id()) == obstacle_ids.end())
+          continue;
+
+        cell->get_dof_indices(dof_indices);
+        for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+          if (fe->system_to_component_index(i).first < dim &&
+              fe->has_support_on_face(i, f))
+            obstacle_dofs.add_index(dof_indices[i]);
+      }
+    }
+    obstacle_dofs.compress();
+
+    // The residual of these DoFs is integrated over all the owned cells
+    // having some of them.
+    for (const auto &cell : locally_owned_cells)
+    {
+      cell->get_dof_indices(dof_indices);
+      if (std::any_of(dof_indices.begin(),
+                      dof_indices.end(),
+                      [this](const types::global_dof_index &index)
+                      { return obstacle_dofs.is_element(index); }))
+        obstacle_cells.push_back(cell);
+    }
+
+    solution_previous.reinit(block_owned_dofs, block_relevant_dofs, MPI_COMM_WORLD);
+  }
+
+  pcout << "  Obstacle faces on this process: " << obstacle_faces.size();
+  if (force_method == ForceMethod::Volume)
+    pcout << ", cells around the obstacle: " << obstacle_cells.size();
+  pcout << std::endl;
+}
+
+template <int dim>
+void NavierStokes<dim>::setup_boundary_values()
+{
+  pcout << "  Computing the Dirichlet boundary values" << std::endl;
+
+  std::map<types::global_dof_index, double> inlet_values;
+  std::map<types::global_dof_index, double> wall_values;
+  std::map<types::boundary_id, const Function<dim> *> boundary_functions;
+
+  // We interpolate first the inlet velocity condition alone, then the wall
+  // condition alone, so that the latter "win" over the former where the two
+  // boundaries touch.
+  const FEValuesExtractors::Vector velocity(0);
+
+  inlet_velocity.set_time(0.0);
+  boundary_functions[inlet_id] = &inlet_velocity;
+  VectorTools::interpolate_boundary_values(dof_handler,
+                                           boundary_functions,
+                                           inlet_values,
+                                           fe->component_mask(velocity));
+
+  boundary_functions.clear();
+  Functions::ZeroFunction<dim> zero_function(dim + 1);
+  for (const types::boundary_id id : wall_ids)
+    boundary_functions[id] = &zero_function;
+  VectorTools::interpolate_boundary_values(dof_handler,
+                                           boundary_functions,
+                                           wall_values,
+                                           fe->component_mask(velocity));
+
+  boundary_values = inlet_values;
+  for (const auto &wall_value : wall_values)
+    boundary_values[wall_value.first] = wall_value.second;
+
+  // If the inlet velocity depends on time, we record the component and the
+  // support point of each inlet DoF, so that its value (the nodal
+  // interpolant) can be re-evaluated directly at every time step.
+  inlet_dofs.clear();
+  if (inlet_velocity.is_time_dependent())
+  {
+    const MappingFE<dim> mapping(FE_SimplexP<dim>(1));
+    const std::vector<Point<dim>> &unit_support_points =
+        fe->get_unit_support_points();
+    std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+    std::map<types::global_dof_index, InletDoF> found_dofs;
+
+    for (const auto &cell : dof_handler.active_cell_iterators())
+    {
+      if (cell->is_artificial() || !cell->at_boundary())
+        continue;
+
+      for (unsigned int f = 0; f < cell->n_faces(); ++f)
+      {
+        if (!cell->face(f)->at_boundary() ||
+            cell->face(f)->boundary_id() != inlet_id)
+          continue;
+
+        cell->get_dof_indices(dof_indices);
+        for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+        {
+          const unsigned int component = fe->system_to_component_index(i).first;
+          if (component >= dim || !fe->has_support_on_face(i, f) ||
+              inlet_values.count(dof_indices[i]) == 0 ||
+              wall_values.count(dof_indices[i]) > 0)
+            continue;
+
+          found_dofs[dof_indices[i]] = {
+              dof_indices[i],
+              component,
+              mapping.transform_unit_to_real_cell(cell, unit_support_points[i])};
+        }
+      }
+    }
+
+    for (const auto &found_dof : found_dofs)
+      inlet_dofs.push_back(found_dof.second);
+  }
+
+  update_boundary_values(0.0);
+}
+
+template <int dim>
+void NavierStokes<dim>::update_boundary_values(const double &time)
+{
+  inlet_velocity.set_time(time);
+  for (const InletDoF &inlet_dof : inlet_dofs)
+    boundary_values[inlet_dof.index] =
+        inlet_velocity.value(inlet_dof.point, inlet_dof.component);
+
+  if (dirichlet_method == DirichletMethod::Constraints)
+  {
+    dirichlet_constraints.clear();
+    dirichlet_constraints.reinit(locally_relevant_dofs);
+    for (const auto &boundary_value : boundary_values)
+    {
+      dirichlet_constraints.add_line(boundary_value.first);
+      dirichlet_constraints.set_inhomogeneity(boundary_value.first,
+                                              boundary_value.second);
+    }
+    dirichlet_constraints.close();
+  }
+}
+
+// https://www.dealii.org/current/doxygen/deal.II/code_gallery_time_dependent_navier_stokes.html
+template <int dim>
+void NavierStokes<dim>::assemble(const double time)
+{
+  pcout << "===============================================" << std::endl;
+  pcout << "Assembling the system" << std::endl;
+
+  // The Dirichlet values are computed once in setup(), and only updated here
+  // if the inlet velocity depends on time.
+  if (inlet_velocity.is_time_dependent())
+  {
+    Profiler::Scope scope(profiler, "boundary conditions");
+    update_boundary_values(time);
+  }
+
+  profiler.enter("assembly");
+
+  // Start from the time-invariant part of the matrix, assembled once in
+  // setup(), and only add the convective term. With constraints, the whole
+  // matrix is assembled cell by cell instead.
+  const bool use_constraints = dirichlet_method == DirichletMethod::Constraints;
+
+  // The batched engine does not distribute through the constraints, so the
+  // cell-wise one is used with them whatever the engine set.
+  const bool batched =
+      assembly_engine == AssemblyEngine::Batched && !use_constraints;
+
+  if (use_constraints)
+    system_matrix = 0.0;
+  else
+    system_matrix.copy_from(constant_matrix);
+  system_rhs = 0.0;
+
+  // Only the loop over the cells and the compress are timed, so that the
+  // assembly rate compares the engines and not the boundary conditions.
+  const auto t0_a = std::chrono::high_resolution_clock::now();
+
+  // The locally owned cells are distributed among the worker threads of this
+  // process. Each thread computes local matrices in its own scratch data, and
+  // the copier adds them to the global objects one cell (or one batch of
+  // cells) at a time.
+  if (batched)
+  {
+    const BatchAssemblyScratchData sample_scratch(*fe,
+                                                  *quadrature,
+                                                  *quadrature_face);
+
+    WorkStream::run(
+        batch_starts.cbegin(),
+        batch_starts.cend(),
+        [this](const std::vector<unsigned int>::const_iterator &batch,
+               BatchAssemblyScratchData &scratch,
+               BatchAssemblyCopyData &copy_data)
+        { local_assemble_batch(batch, scratch, copy_data); },
+        [this](const BatchAssemblyCopyData &copy_data)
+        { copy_batch_to_global(copy_data); },
+        sample_scratch,
+        BatchAssemblyCopyData(sample_scratch.velocity_dofs.size()));
+  }
+  else
+  {
+    using CellFilter = FilteredIterator<typename DoFHandler<dim>::active_cell_iterator>;
+
+    dispatch_kernel(
+        [&](auto n_dofs)
+        {
+          WorkStream::run(
+              CellFilter(IteratorFilters::LocallyOwnedCell(),
+                         dof_handler.begin_active()),
+              CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.end()),
+              [this, use_constraints](
+                  const typename DoFHandler<dim>::active_cell_iterator &cell,
+                  AssemblyScratchData &scratch,
+                  AssemblyCopyData &copy_data)
+              {
+                if (use_constraints)
+                  this->template local_assemble_constant<decltype(n_dofs)::value>(
+                      cell, scratch, copy_data, false);
+                this->template local_assemble_system<decltype(n_dofs)::value>(
+                    cell, scratch, copy_data, use_constraints);
+              },
+              [this, use_constraints](const AssemblyCopyData &copy_data)
+              {
+                if (use_constraints)
+                  dirichlet_constraints.distribute_local_to_global(
+                      copy_data.cell_matrix,
+                      copy_data.cell_rhs,
+                      copy_data.dof_indices,
+                      system_matrix,
+                      system_rhs);
+                else
+                  copy_local_to_global(copy_data);
+              },
+              AssemblyScratchData(*fe, *quadrature, *quadrature_face),
+              AssemblyCopyData(fe->dofs_per_cell));
+        });
+  }
+
+  system_matrix.compress(VectorOperation::add);
+  system_rhs.compress(VectorOperation::add);
+
+  const auto t1_a = std::chrono::high_resolution_clock::now();
+
+  profiler.leave();
+  const auto dt_a = std::chrono::duration_cast<std::chrono::milliseconds>(t1_a - t0_a).count();
+
+  const double cells_per_second =
+      locally_owned_cells.size() /
+      std::chrono::duration<double>(t1_a - t0_a).count();
+
+  pcout << "  Assembly time: " << dt_a << " ms on "
+        << MultithreadInfo::n_threads() << " thread(s), "
+        << (batched ? "batched" : "cell-wise")
+        << " engine, " << cells_per_second << " cells/s" << std::endl;
+
+  time_assemble.emplace_back(dt_a);
+
+  // Dirichlet boundary conditions, with the values computed by
+  // setup_boundary_values(). With constraints, they have already been imposed
+  // while adding the local matrices.
+  if (!use_constraints)
+  {
+    Profiler::Scope scope(profiler, "boundary conditions");
+
+    if (!matrix_free)
+    {
+      MatrixTools::apply_boundary_values(
+          boundary_values, system_matrix, solution, system_rhs, false);
+    }
+    else
+    {
+      // The Dirichlet rows of the velocity-velocity block are replaced by the
+      // identity inside the operator. Here we only clear the same rows of B^T
+      // and set the boundary values in the right-hand side and in the initial
+      // guess.
+      std::vector<types::global_dof_index> constrained_rows;
+      for (const auto &boundary_value : boundary_values)
+        if (locally_owned_dofs.is_element(boundary_value.first))
+        {
+          constrained_rows.push_back(boundary_value.first);
+          system_rhs(boundary_value.first) = boundary_value.second;
+          solution_owned(boundary_value.first) = boundary_value.second;
+        }
+      system_rhs.compress(VectorOperation::insert);
+      solution_owned.compress(VectorOperation::insert);
+
+      system_matrix.block(0, 1).clear_rows(constrained_rows);
+
+      oseen_operator.reinit(solution, deltat, boundary_values);
+    }
+  }
+}
+
+template <int dim>
+void NavierStokes<dim>::assemble_constant(const bool &with_pressure_mass)
+{
+  pcout << "  Assembling the time-invariant matrices" << std::endl;
+
+  constant_matrix = 0.0;
+  if (with_pressure_mass)
+    pressure_mass = 0.0;
+
+  using CellFilter = FilteredIterator<typename DoFHandler<dim>::active_cell_iterator>;
+
+  dispatch_kernel(
+      [&](auto n_dofs)
+      {
+        WorkStream::run(
+            CellFilter(IteratorFilters::LocallyOwnedCell(),
+                       dof_handler.begin_active()),
+            CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.end()),
+            [this, with_pressure_mass](
+                const typename DoFHandler<dim>::active_cell_iterator &cell,
+                AssemblyScratchData &scratch,
+                AssemblyCopyData &copy_data)
+            {
+              this->template local_assemble_constant<decltype(n_dofs)::value>(
+                  cell, scratch, copy_data, with_pressure_mass);
+            },
+            [this, with_pressure_mass](const AssemblyCopyData &copy_data)
+            {
+              constant_matrix.add(copy_data.dof_indices, copy_data.cell_matrix);
+              if (with_pressure_mass)
+                pressure_mass.add(copy_data.dof_indices,
+                                  copy_data.cell_pressure_mass_matrix);
+            },
+            AssemblyScratchData(*fe, *quadrature, *quadrature_face),
+            AssemblyCopyData(fe->dofs_per_cell));
+      });
+
+  constant_matrix.compress(VectorOperation::add);
+  if (with_pressure_mass)
+    pressure_mass.compress(VectorOperation::add);
+}
+
+template <int dim>
+template <int n_dofs_static>
+void NavierStokes<dim>::local_assemble_constant(
+    const typename DoFHandler<dim>::active_cell_iterator &cell,
+    AssemblyScratchData &scratch,
+    AssemblyCopyData &copy_data,
+    const bool &with_pressure_mass)
+{
+  const unsigned int dofs_per_cell =
+      n_dofs_static > 0 ? n_dofs_static : fe->dofs_per_cell;
+  const unsigned int n_q = quadrature->size();
+
+  AssertDimension(dofs_per_cell, fe->dofs_per_cell);
+
+  FEValues<dim> &fe_values = scratch.fe_values;
+
+  const std::vector<unsigned int> &component = scratch.component;
+  const auto &dofs = scratch.template get_dof_lists<n_dofs_static>();
+  std::vector<double> &phi = scratch.phi;
+  std::vector<Tensor<1, dim>> &grad_phi = scratch.grad_phi;
+
+  FullMatrix<double> &cell_matrix = copy_data.cell_matrix;
+  FullMatrix<double> &cell_pressure_mass_matrix =
+      copy_data.cell_pressure_mass_matrix;
+
+  fe_values.reinit(cell);
+
+  cell_matrix = 0.0;
+  cell_pressure_mass_matrix = 0.0;
+
+  for (unsigned int q = 0; q < n_q; ++q)
+  {
+    const double JxW = fe_values.JxW(q);
+
+    // Shape function values and gradients are read once per quadrature
+    // point, and then only the nonzero (i, j) couplings are computed.
+    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+    {
+      phi[i] = fe_values.shape_value(i, q);
+      grad_phi[i] = fe_values.shape_grad(i, q);
+    }
+
+    // Viscosity term and time derivative, which only couple velocity shape
+    // functions of the same component. In matrix-free mode the
+    // velocity-velocity block is applied by the OseenOperator, so it is not
+    // assembled here.
+    if (!matrix_free)
+    {
+      for (const auto &component_dofs : dofs.velocity_by_component)
+        for (const unsigned int i : component_dofs)
+          for (const unsigned int j : component_dofs)
+            cell_matrix(i, j) += (nu * (grad_phi[i] * grad_phi[j]) +
+                                  phi[i] * phi[j] / deltat) *
+                                 JxW;
+    }
+
+    // Pressure terms in the momentum and continuity equations. The
+    // divergence of a velocity shape function of component c is the c-th
+    // entry of the gradient of its nonzero component.
+    for (const unsigned int i : dofs.velocity)
+    {
+      const double div_i = grad_phi[i][component[i]] * JxW;
+      for (const unsigned int j : dofs.pressure)
+      {
+        cell_matrix(i, j) -= div_i * phi[j];
+        cell_matrix(j, i) -= div_i * phi[j];
+      }
+    }
+
+    // Pressure mass matrix.
+    if (with_pressure_mass)
+      for (const unsigned int i : dofs.pressure)
+        for (const unsigned int j : dofs.pressure)
+          cell_pressure_mass_matrix(i, j) += phi[i] * phi[j] / nu * JxW;
+  }
+
+  cell->get_dof_indices(copy_data.dof_indices);
+}
+
+template <int dim>
+template <int n_dofs_static>
+void NavierStokes<dim>::local_assemble_system(
+    const typename DoFHandler<dim>::active_cell_iterator &cell,
+    AssemblyScratchData &scratch,
+    AssemblyCopyData &copy_data,
+    const bool &keep_cell_matrix)
+{
+  const unsigned int dofs_per_cell =
+      n_dofs_static > 0 ? n_dofs_static : fe->dofs_per_cell;
+  const unsigned int n_q = quadrature->size();
+  const unsigned int n_q_face = quadrature_face->size();
+
+  AssertDimension(dofs_per_cell, fe->dofs_per_cell);
+
+  FEValues<dim> &fe_values = scratch.fe_values;
+  FEFaceValues<dim> &fe_face_values = scratch.fe_face_values;
+  std::vector<Tensor<1, dim>> &current_velocity_values =
+      scratch.current_velocity_values;
+
+  const std::vector<unsigned int> &component = scratch.component;
+  const auto &dofs = scratch.template get_dof_lists<n_dofs_static>();
+  std::vector<double> &phi = scratch.phi;
+  std::vector<Tensor<1, dim>> &grad_phi = scratch.grad_phi;
+  std::vector<Tensor<1, dim>> &convected_grad_phi = scratch.convected_grad_phi;
+
+  FullMatrix<double> &cell_matrix = copy_data.cell_matrix;
+  Vector<double> &cell_rhs = copy_data.cell_rhs;
+
+  FEValuesExtractors::Vector velocity(0);
+
+  fe_values.reinit(cell);
+
+  if (!keep_cell_matrix)
+    cell_matrix = 0.0;
+  cell_rhs = 0.0;
+
+  //
+  fe_values[velocity].get_function_values(solution, current_velocity_values);
+
+  // The data are evaluated at all quadrature points at once, into buffers of
+  // the scratch object, and not at all if they vanish.
+  const bool has_forcing_term = !forcing_term.is_zero();
+  if (has_forcing_term)
+    forcing_term.vector_value_list(fe_values.get_quadrature_points(),
+                                   scratch.forcing_term_values);
+
+  for (unsigned int q = 0; q < n_q; ++q)
+  {
+    const double JxW = fe_values.JxW(q);
+    const Tensor<1, dim> &w = current_velocity_values[q];
+
+    for (unsigned int i = 0; i < dofs_per_cell; ++i)
+    {
+      phi[i] = fe_values.shape_value(i, q);
+      grad_phi[i] = fe_values.shape_grad(i, q);
+    }
+
+    // The convective term is the only contribution to the matrix that
+    // changes between time steps. In matrix-free mode it is applied by the
+    // OseenOperator. Since phi_j has the single nonzero component c_j,
+    // w * grad(phi_j) = w[c_j] grad(phi_j), and its product with phi_i only
+    // keeps the entry c_i.
+    if (!matrix_free)
+    {
+      for (const unsigned int j : dofs.velocity)
+        convected_grad_phi[j] = w[component[j]] * grad_phi[j];
+
+      for (const unsigned int i : dofs.velocity)
+      {
+        const unsigned int c_i = component[i];
+        const double phi_i = phi[i] * JxW;
+        for (const unsigned int j : dofs.velocity)
+          cell_matrix(i, j) += phi_i * convected_grad_phi[j][c_i];
+      }
+    }
+
+    // Forcing term and time derivative of the previous solution.
+    for (const unsigned int i : dofs.velocity)
+    {
+      const unsigned int c_i = component[i];
+      double f = w[c_i] / deltat;
+      if (has_forcing_term)
+        f += scratch.forcing_term_values[q][c_i];
+      cell_rhs(i) += f * phi[i] * JxW;
+    }
+  }
+
+  // Boundary integral for Neumann BCs.
+  if (!function_h.is_zero() && cell->at_boundary())
+  {
+    for (unsigned int f = 0; f < cell->n_faces(); ++f)
+    {
+      if (cell->face(f)->at_boundary() &&
+          cell->face(f)->boundary_id() != inlet_id &&
+          cell->face(f)->boundary_id() != outlet_id)
+      {
+        fe_face_values.reinit(cell, f);
+        function_h.vector_value_list(fe_face_values.get_quadrature_points(),
+                                     scratch.neumann_values);
+
+        for (unsigned int q = 0; q < n_q_face; ++q)
+        {
+          const Vector<double> &neumann_loc = scratch.neumann_values[q];
+
+          for (const unsigned int i : dofs.velocity)
+            cell_rhs(i) += neumann_loc[component[i]] *
+                           fe_face_values.shape_value(i, q) *
+                           fe_face_values.JxW(q);
+        }
+      }
+    }
+  }
+
+  cell->get_dof_indices(copy_data.dof_indices);
+}
+
+template <int dim>
+void NavierStokes<dim>::copy_local_to_global(const AssemblyCopyData &copy_data)
+{
+  if (!matrix_free)
+    system_matrix.add(copy_data.dof_indices, copy_data.cell_matrix);
+  system_rhs.add(copy_data.dof_indices, copy_data.cell_rhs);
+}
+
+template <int dim>
+void NavierStokes<dim>::local_assemble_batch(
+    const std::vector<unsigned int>::const_iterator &batch,
+    BatchAssemblyScratchData &scratch,
+    BatchAssemblyCopyData &copy_data)
+{
+  using VectorizedDouble = VectorizedArray<double>;
+
+  const unsigned int first_cell = *batch;
+  const unsigned int n_filled_lanes =
+      std::min<unsigned int>(n_lanes, locally_owned_cells.size() - first_cell);
+  const unsigned int n_u = scratch.velocity_dofs.size();
+  const unsigned int n_q = quadrature->size();
+  const unsigned int n_q_face = quadrature_face->size();
+
+  const std::vector<unsigned int> &component = scratch.component;
+
+  const bool has_forcing_term = !forcing_term.is_zero();
+
+  copy_data.n_filled_lanes = n_filled_lanes;
+
+  // Gather the data of each cell into its lane. The lanes past the end of the
+  // last batch are left to zero, so that their (discarded) contributions
+  // vanish.
+  scratch.inverse_jacobian = Tensor<2, dim, VectorizedDouble>();
+  for (unsigned int q = 0; q < n_q; ++q)
+  {
+    scratch.JxW[q] = 0.0;
+    scratch.forcing_values[q] = Tensor<1, dim, VectorizedDouble>();
+  }
+  for (unsigned int k = 0; k < n_u; ++k)
+    scratch.dof_values[k] = 0.0;
+
+  for (unsigned int lane = 0; lane < n_filled_lanes; ++lane)
+  {
+    const auto &cell = locally_owned_cells[first_cell + lane];
+
+    scratch.fe_values.reinit(cell);
+    cell->get_dof_indices(scratch.local_dof_indices);
+
+    // The mapping of a simplex is affine, so that its inverse Jacobian is the
+    // same at all quadrature points.
+    const DerivativeForm<1, dim, dim> &inverse_jacobian =
+        scratch.fe_values.inverse_jacobian(0);
+    for (unsigned int d = 0; d < dim; ++d)
+      for (unsigned int e = 0; e < dim; ++e)
+        scratch.inverse_jacobian[d][e][lane] = inverse_jacobian[d][e];
+
+    for (unsigned int k = 0; k < n_u; ++k)
+    {
+      const types::global_dof_index index =
+          scratch.local_dof_indices[scratch.velocity_dofs[k]];
+      copy_data.dof_indices[lane][k] = index;
+      scratch.dof_values[k][lane] = solution(index);
+    }
+
+    for (unsigned int q = 0; q < n_q; ++q)
+      scratch.JxW[q][lane] = scratch.fe_values.JxW(q);
+
+    if (has_forcing_term)
+    {
+      forcing_term.vector_value_list(scratch.fe_values.get_quadrature_points(),
+                                     scratch.forcing_term_values);
+      for (unsigned int q = 0; q < n_q; ++q)
+        for (unsigned int d = 0; d < dim; ++d)
+          scratch.forcing_values[q][d][lane] = scratch.forcing_term_values[q][d];
+    }
+  }
+
+  // Compute the local matrices and right-hand sides of all cells at once.
+  std::fill(scratch.cell_matrix.begin(), scratch.cell_matrix.end(), 0.0);
+  std::fill(scratch.cell_rhs.begin(), scratch.cell_rhs.end(), 0.0);
+
+  for (unsigned int q = 0; q < n_q; ++q)
+  {
+    // Convective velocity, interpolated from the DoF values.
+    Tensor<1, dim, VectorizedDouble> w;
+    for (unsigned int k = 0; k < n_u; ++k)
+      w[component[k]] += scratch.phi(k, q) * scratch.dof_values[k];
+
+    const VectorizedDouble JxW = scratch.JxW[q];
+
+    if (!matrix_free)
+    {
+      // grad(phi_k) = J^{-T} times the reference gradient.
+      for (unsigned int k = 0; k < n_u; ++k)
+      {
+        const Tensor<1, dim> &ref_grad = scratch.ref_grad_phi(k, q);
+
+        Tensor<1, dim, VectorizedDouble> grad_phi;
+        for (unsigned int d = 0; d < dim; ++d)
+          for (unsigned int e = 0; e < dim; ++e)
+            grad_phi[e] += ref_grad[d] * scratch.inverse_jacobian[d][e];
+
+        scratch.convected_grad_phi[k] = w[component[k]] * grad_phi;
+      }
+
+      for (unsigned int i = 0; i < n_u; ++i)
+      {
+        const unsigned int c_i = component[i];
+        const VectorizedDouble phi_i = scratch.phi(i, q) * JxW;
+        VectorizedDouble *row = &scratch.cell_matrix[i * n_u];
+        for (unsigned int j = 0; j < n_u; ++j)
+          row[j] += phi_i * scratch.convected_grad_phi[j][c_i];
+      }
+    }
+
+    for (unsigned int i = 0; i < n_u; ++i)
+    {
+      const unsigned int c_i = component[i];
+      VectorizedDouble f = w[c_i] / deltat;
+      if (has_forcing_term)
+        f += scratch.forcing_values[q][c_i];
+      scratch.cell_rhs[i] += f * scratch.phi(i, q) * JxW;
+    }
+  }
+
+  // Scatter the lanes into the local matrices of the single cells, and add
+  // the boundary integral for Neumann BCs, which only concerns few cells.
+  for (unsigned int lane = 0; lane < n_filled_lanes; ++lane)
+  {
+    FullMatrix<double> &cell_matrix = copy_data.cell_matrix[lane];
+    Vector<double> &cell_rhs = copy_data.cell_rhs[lane];
+
+    if (!matrix_free)
+      for (unsigned int i = 0; i < n_u; ++i)
+        for (unsigned int j = 0; j < n_u; ++j)
+          cell_matrix(i, j) = scratch.cell_matrix[i * n_u + j][lane];
+
+    for (unsigned int i = 0; i < n_u; ++i)
+      cell_rhs(i) = scratch.cell_rhs[i][lane];
+
+    const auto &cell = locally_owned_cells[first_cell + lane];
+    if (function_h.is_zero() || !cell->at_boundary())
+      continue;
+
+    for (unsigned int f = 0; f < cell->n_faces(); ++f)
+    {
+      if (cell->face(f)->at_boundary() &&
+          cell->face(f)->boundary_id() != inlet_id &&
+          cell->face(f)->boundary_id() != outlet_id)
+      {
+        scratch.fe_face_values.reinit(cell, f);
+        function_h.vector_value_list(
+            scratch.fe_face_values.get_quadrature_points(),
+            scratch.neumann_values);
+
+        for (unsigned int q = 0; q < n_q_face; ++q)
+        {
+          for (unsigned int i = 0; i < n_u; ++i)
+            cell_rhs(i) +=
+                scratch.neumann_values[q][component[i]] *
+                scratch.fe_face_values.shape_value(scratch.velocity_dofs[i], q) *
+                scratch.fe_face_values.JxW(q);
+        }
+      }
+    }
+  }
+}
+
+template <int dim>
+void NavierStokes<dim>::copy_batch_to_global(const BatchAssemblyCopyData &copy_data)
+{
+  for (unsigned int lane = 0; lane < copy_data.n_filled_lanes; ++lane)
+  {
+    if (!matrix_free)
+      system_matrix.add(copy_data.dof_indices[lane], copy_data.cell_matrix[lane]);
+    system_rhs.add(copy_data.dof_indices[lane], copy_data.cell_rhs[lane]);
+  }
+}
+
+template <int dim>
+void NavierStokes<dim>::OseenOperator::initialize(
+    const DoFHandler<dim> &dof_handler_,
+    const Quadrature<dim> &quadrature_,
+    const TrilinosWrappers::BlockSparseMatrix &system_matrix_,
+    const IndexSet &velocity_owned_dofs,
+    const IndexSet &velocity_relevant_dofs,
+    const double &nu_)
+{
+  dof_handler = &dof_handler_;
+  quadrature = &quadrature_;
+  system_matrix = &system_matrix_;
+  nu = nu_;
+
+  const FiniteElement<dim> &fe = dof_handler->get_fe();
+
+  fe_values = std::make_unique<FEValues<dim>>(fe,
+                                              *quadrature,
+                                              update_values |
+                                                  update_gradients |
+                                                  update_JxW_values);
+
+  velocity_local_dofs.clear();
+  for (unsigned int i = 0; i < fe.dofs_per_cell; ++i)
+    if (fe.system_to_component_index(i).first < dim)
+      velocity_local_dofs.push_back(i);
+
+  diagonal.reinit(velocity_owned_dofs, MPI_COMM_WORLD);
+  src_ghosted.reinit(velocity_owned_dofs,
+                     velocity_relevant_dofs,
+                     MPI_COMM_WORLD);
+}
+
+template <int dim>
+void NavierStokes<dim>::OseenOperator::reinit(
+    const TrilinosWrappers::MPI::BlockVector &convective_velocity,
+    const double &deltat_,
+    const std::map<types::global_dof_index, double> &boundary_values)
+{
+  deltat = deltat_;
+
+  // Cache the convective velocity at the quadrature points.
+  const unsigned int n_q = quadrature->size();
+  FEValuesExtractors::Vector velocity(0);
+  std::vector<Tensor<1, dim>> current_velocity_values(n_q);
+
+  convective_velocity_values.clear();
+  for (const auto &cell : dof_handler->active_cell_iterators())
+  {
+    if (!cell->is_locally_owned())
+      continue;
+
+    fe_values->reinit(cell);
+    (*fe_values)[velocity].get_function_values(convective_velocity,
+                                               current_velocity_values);
+    convective_velocity_values.insert(convective_velocity_values.end(),
+                                      current_velocity_values.begin(),
+                                      current_velocity_values.end());
+  }
+
+  constrained_dofs.clear();
+  for (const auto &boundary_value : boundary_values)
+    if (diagonal.locally_owned_elements().is_element(boundary_value.first))
+      constrained_dofs.push_back(boundary_value.first);
+
+  // Compute the diagonal of the velocity-velocity block.
+  cell_loop(diagonal, diagonal, true);
+  for (const auto &i : constrained_dofs)
+    diagonal(i) = 1.0;
+  diagonal.compress(VectorOperation::insert);
+}
+
+template <int dim>
+void NavierStokes<dim>::OseenOperator::vmult(
+    TrilinosWrappers::MPI::BlockVector &dst,
+    const TrilinosWrappers::MPI::BlockVector &src) const
+{
+  // Momentum equation: F u + B^T p.
+  vmult(dst.block(0), src.block(0));
+  system_matrix->block(0, 1).vmult_add(dst.block(0), src.block(1));
+
+  // Continuity equation: B u.
+  system_matrix->block(1, 0).vmult(dst.block(1), src.block(0));
+}
+
+template <int dim>
+void NavierStokes<dim>::OseenOperator::vmult(
+    TrilinosWrappers::MPI::Vector &dst,
+    const TrilinosWrappers::MPI::Vector &src) const
+{
+  src_ghosted = src;
+  cell_loop(dst, src_ghosted, false);
+
+  // Dirichlet rows are replaced by the identity.
+  for (const auto &i : constrained_dofs)
+    dst(i) = src(i);
+  dst.compress(VectorOperation::insert);
+}
+
+template <int dim>
+void NavierStokes<dim>::OseenOperator::cell_loop(
+    TrilinosWrappers::MPI::Vector &dst,
+    const TrilinosWrappers::MPI::Vector &src,
+    const bool diagonal_only) const
+{
+  const unsigned int dofs_per_cell = dof_handler->get_fe().dofs_per_cell;
+  const unsigned int n_u_cell = velocity_local_dofs.size();
+  const unsigned int n_q = quadrature->size();
+
+  FEValuesExtractors::Vector velocity(0);
+
+  std::vector<types::global_dof_index> dof_indices(dofs_per_cell);
+  std::vector<types::global_dof_index> velocity_dof_indices(n_u_cell);
+  Vector<double> cell_src(n_u_cell);
+  Vector<double> cell_dst(n_u_cell);
+
+  dst = 0.0;
+
+  unsigned int cell_q = 0;
+  for (const auto &cell : dof_handler->active_cell_iterators())
+  {
+    if (!cell->is_locally_owned())
+      continue;
+
+    fe_values->reinit(cell);
+    cell->get_dof_indices(dof_indices);
+
+    // Velocity DoFs come first in the global numbering, so their global index
+    // is also their index in the velocity block.
+    for (unsigned int k = 0; k < n_u_cell; ++k)
+    {
+      velocity_dof_indices[k] = dof_indices[velocity_local_dofs[k]];
+      if (!diagonal_only)
+        cell_src[k] = src(velocity_dof_indices[k]);
+    }
+
+    cell_dst = 0.0;
+
+    for (unsigned int q = 0; q < n_q; ++q, ++cell_q)
+    {
+      const Tensor<1, dim> &w = convective_velocity_values[cell_q];
+
+      if (diagonal_only)
+      {
+        for (unsigned int k = 0; k < n_u_cell; ++k)
+        {
+          const unsigned int i = velocity_local_dofs[k];
+          cell_dst[k] += (nu *
+                              scalar_product((*fe_values)[velocity].gradient(i, q),
+                                             (*fe_values)[velocity].gradient(i, q)) +
+                          (*fe_values)[velocity].value(i, q) *
+                              (*fe_values)[velocity].value(i, q) / deltat +
+                          w * (*fe_values)[velocity].gradient(i, q) *
+                              (*fe_values)[velocity].value(i, q)) *
+                         fe_values->JxW(q);
+        }
+        continue;
+      }
+
+      // Evaluate the velocity and its gradient at the quadrature point.
+      Tensor<1, dim> u_q;
+      Tensor<2, dim> grad_u_q;
+      for (unsigned int k = 0; k < n_u_cell; ++k)
+      {
+        const unsigned int j = velocity_local_dofs[k];
+        u_q += cell_src[k] * (*fe_values)[velocity].value(j, q);
+        grad_u_q += cell_src[k] * (*fe_values)[velocity].gradient(j, q);
+      }
+
+      // Same terms as the velocity-velocity block in assemble().
+      const Tensor<1, dim> convection = w * grad_u_q;
+
+      for (unsigned int k = 0; k < n_u_cell; ++k)
+      {
+        const unsigned int i = velocity_local_dofs[k];
+        cell_dst[k] += (nu * scalar_product((*fe_values)[velocity].gradient(i, q),
+                                            grad_u_q) +
+                        (*fe_values)[velocity].value(i, q) * u_q / deltat +
+                        convection * (*fe_values)[velocity].value(i, q)) *
+                       fe_values->JxW(q);
+      }
+    }
+
+    dst.add(velocity_dof_indices, cell_dst);
+  }
+
+  dst.compress(VectorOperation::add);
+}
+
+template <int dim>
+void NavierStokes<dim>::solve_time_step()
+{
+  pcout << "===============================================" << std::endl;
+
+  const unsigned int maxiter = 10000;
+  const double tol = solver_tolerance * system_rhs.l2_norm();
+
+  SolverControl solver_control(maxiter, tol);
+
+  // Both solvers restart every gmres_restart_length iterations (GMRES counts
+  // the two extra vectors it needs in max_n_tmp_vectors).
+  SolverGMRES<TrilinosWrappers::MPI::BlockVector> solver_gmres(
+      solver_control,
+      SolverGMRES<TrilinosWrappers::MPI::BlockVector>::AdditionalData(
+          gmres_restart_length + 2));
+  SolverFGMRES<TrilinosWrappers::MPI::BlockVector> solver_fgmres(
+      solver_control,
+      SolverFGMRES<TrilinosWrappers::MPI::BlockVector>::AdditionalData(
+          gmres_restart_length));
+
+  const std::string solver_name =
+      outer_solver_type == OuterSolverType::FGMRES ? "FGMRES" : "GMRES";
+
+  // Set the stopping criterion of the inner solves of the preconditioner in
+  // use, with the given relative tolerance.
+  const auto set_inner_solve_tolerance = [this](const double &tolerance)
+  {
+    InnerSolve inner_solve;
+    inner_solve.type = inner_solve_type;
+    inner_solve.tolerance = tolerance;
+    inner_solve.n_iterations = inner_solve_iterations;
+
+    if (!matrix_free)
+      dispatch_preconditioner([&inner_solve](auto &preconditioner_)
+                              { preconditioner_.set_inner_solve(inner_solve); });
+    else
+      preconditioner_matrix_free.set_inner_solve(inner_solve);
+  };
+
+  // In Adaptive mode, the inner tolerance is relaxed after each outer
+  // iteration, in proportion to the reduction of the outer residual.
+  if (inner_solve_type == InnerSolveType::Adaptive)
+  {
+    const auto relax_inner_tolerance =
+        [&, initial_residual = 0.0](const unsigned int iteration,
+                                    const double residual,
+                                    const TrilinosWrappers::MPI::BlockVector &) mutable
+    {
+      if (iteration == 0)
+        initial_residual = residual;
+      else if (residual > 0.0)
+        set_inner_solve_tolerance(
+            std::min(inner_tolerance_max,
+                     inner_tolerance * initial_residual / residual));
+      return SolverControl::success;
+    };
+    solver_gmres.connect(relax_inner_tolerance);
+    solver_fgmres.connect(relax_inner_tolerance);
+  }
+
+  // Start from the previous solution, or from a guess computed from the last
+  // time steps (the system must already be assembled for the projection).
+  switch (initial_guess_type)
+  {
+  case InitialGuessType::Previous:
+    break;
+  case InitialGuessType::Linear:
+    solution_history.extrapolate(deltat, 1, solution_owned);
+    break;
+  case InitialGuessType::Quadratic:
+    solution_history.extrapolate(deltat, 2, solution_owned);
+    break;
+  case InitialGuessType::Projection:
+    if (!matrix_free)
+      solution_history.project(system_matrix, system_rhs, solution_owned);
+    else
+      solution_history.project(oseen_operator, system_rhs, solution_owned);
+    break;
+  }
+
+  // The preconditioner is kept across time steps, and only rebuilt if the
+  // previous solve took too many iterations or if it is too old.
+  const bool rebuild_preconditioner =
+      preconditioner_age >= preconditioner_max_age ||
+      (!gmres_iterations.empty() &&
+       gmres_iterations.back() > preconditioner_max_iterations);
+
+	long dt_p = 0;
+  bool preconditioner_initialized = false;
+
+  const unsigned long long inner_iterations_before = n_inner_iterations();
+
+  const auto initialize_preconditioner = [&]()
+  {
+    Profiler::Scope scope(profiler, "preconditioner setup");
+
+    pcout << " Assemblying the preconditioner... " << std::endl;
+
+    const auto t0_p=std::chrono::high_resolution_clock::now();
+
+    if (!matrix_free)
+    {
+      const TrilinosWrappers::SparseMatrix &F = system_matrix.block(0, 0);
+      const TrilinosWrappers::SparseMatrix &B = system_matrix.block(1, 0);
+      const TrilinosWrappers::SparseMatrix &B_T = system_matrix.block(0, 1);
+
+      switch (preconditioner_type)
+      {
+      case PreconditionerType::BlockDiagonal:
+        preconditioner_block_diagonal.initialize(F, pressure_mass.block(1, 1),
+                                                 inner_preconditioner_type,
+                                                 velocity_constant_modes);
+        break;
+      case PreconditionerType::BlockTriangular:
+        preconditioner_block_triangular.initialize(F, pressure_mass.block(1, 1), B,
+                                                   inner_preconditioner_type,
+                                                   velocity_constant_modes);
+        break;
+      case PreconditionerType::SIMPLE:
+        preconditioner_simple.initialize(F, B, B_T, solution_owned,
+                                         inner_preconditioner_type, velocity_constant_modes);
+        break;
+      case PreconditionerType::aSIMPLE:
+        preconditioner_asimple.initialize(F, B, B_T, solution_owned,
+                                          inner_preconditioner_type, velocity_constant_modes);
+        break;
+      case PreconditionerType::LSC:
+        preconditioner_lsc.initialize(F, B, B_T, velocity_lumped_mass,
+                                      inner_preconditioner_type, velocity_constant_modes);
+        break;
+      case PreconditionerType::PCD:
+        assemble_pcd();
+        preconditioner_pcd.initialize(F, B_T, pressure_mass.block(1, 1),
+                                      pressure_laplacian.block(1, 1),
+                                      pressure_convection_diffusion.block(1, 1),
+                                      pcd_free_pressure, nu,
+                                      inner_preconditioner_type, velocity_constant_modes);
+        break;
+      }
+    }
+    else
+    {
+      preconditioner_matrix_free.initialize(oseen_operator, system_matrix.block(1, 0), system_matrix.block(0, 1),
+                                            inner_preconditioner_type);
+    }
+
+    const auto t1_p=std::chrono::high_resolution_clock::now();
+
+    dt_p += std::chrono::duration_cast<std::chrono::milliseconds>(t1_p-t0_p).count();
+    preconditioner_age = 0;
+    preconditioner_initialized = true;
+
+    pcout << "done" << std::endl;
+  };
+
+  if (rebuild_preconditioner)
+    initialize_preconditioner();
+  else
+    pcout << " Reusing the preconditioner built " << preconditioner_age
+          << " step(s) ago" << std::endl;
+
+  pcout << "===============================================" << std::endl;
+
+  pcout << "Solving the linear system with expected maxiter: " << maxiter;
+  pcout << " and tollerance: " << tol << std::endl;
+	
+	const auto t0_s=std::chrono::high_resolution_clock::now();
+
+  {
+    Profiler::Scope scope(profiler, "solve");
+
+    const auto solve_with = [&](auto &solver)
+    {
+      if (!matrix_free)
+        dispatch_preconditioner(
+            [&](const auto &preconditioner_)
+            { solver.solve(system_matrix, solution_owned, system_rhs, preconditioner_); });
+      else
+        solver.solve(oseen_operator, solution_owned, system_rhs, preconditioner_matrix_free);
+    };
+
+    const auto solve_linear_system = [&]()
+    {
+      set_inner_solve_tolerance(inner_tolerance);
+
+      if (outer_solver_type == OuterSolverType::FGMRES)
+        solve_with(solver_fgmres);
+      else
+        solve_with(solver_gmres);
+    };
+
+    if (rebuild_preconditioner)
+      solve_linear_system();
+    else
+    {
+      // A stale preconditioner may not be good enough for the current matrix:
+      // if the solver does not converge, we rebuild it and solve again from the same
+      // initial guess.
+      const TrilinosWrappers::MPI::BlockVector initial_guess = solution_owned;
+      try
+      {
+        solve_linear_system();
+      }
+      catch (const SolverControl::NoConvergence &)
+      {
+        pcout << "  " << solver_name
+              << " did not converge with the reused preconditioner"
+              << std::endl;
+        solution_owned = initial_guess;
+        initialize_preconditioner();
+        solve_linear_system();
+      }
+    }
+  }
+
+	const auto t1_s=std::chrono::high_resolution_clock::now();
+
+	const auto dt_s=std::chrono::duration_cast<std::chrono::milliseconds>(t1_s-t0_s).count();
+  
+  // The inner iterations of an attempt with a stale preconditioner are
+  // counted as well, the outer ones only for the final solve.
+  const unsigned long long n_inner = n_inner_iterations() - inner_iterations_before;
+
+	pcout << "  " << solver_control.last_step() << " " << solver_name
+        << " iterations, " << n_inner << " inner iterations, " << dt_s
+        << " ms" << std::endl;
+
+  profiler.add("outer iterations", solver_control.last_step());
+  profiler.add("inner iterations", n_inner);
+
+  // With constraints, the constrained rows of the system are trivial, and
+  // the Dirichlet values are set here.
+  if (dirichlet_method == DirichletMethod::Constraints)
+    dirichlet_constraints.distribute(solution_owned);
+
+  solution = solution_owned;
+
+  ++preconditioner_age;
+
+	time_solve.emplace_back(dt_s);
+	time_prec.emplace_back(dt_p);
+	gmres_iterations.emplace_back(solver_control.last_step());
+  inner_iterations.emplace_back(n_inner);
+	preconditioner_rebuilt.emplace_back(preconditioner_initialized);
+}
+
+template <int dim>
+void NavierStokes<dim>::output(const unsigned int &time_step, const double &time) const
+{
+  pcout << "===============================================" << std::endl;
+
+  // The DataOut object is shared with the background writer, which may
+  // still be running when this function returns.
+  const auto data_out = std::make_shared<DataOut<dim>>();
+
+  std::vector<DataComponentInterpretation::DataComponentInterpretation>
+      data_component_interpretation(
+          dim, DataComponentInterpretation::component_is_part_of_vector);
+  data_component_interpretation.push_back(
+      DataComponentInterpretation::component_is_scalar);
+  std::vector<std::string> names(dim, "velocity");
+  names.push_back("pressure");
+
+  data_out->add_data_vector(dof_handler,
+                           solution,
+                           names,
+                           data_component_interpretation);
+
+  std::vector<unsigned int> partition_int(mesh.n_active_cells());
+  GridTools::get_subdomain_association(mesh, partition_int);
+  const auto partitioning =
+      std::make_shared<Vector<double>>(partition_int.begin(), partition_int.end());
+  data_out->add_data_vector(*partitioning, "partitioning");
+
+  data_out->build_patches();
+
+  const std::string output_file_name =
+      "output-stokes-" + std::to_string(dim) + "D";
+
+  if (output_format == OutputFormat::HDF5)
+  {
+#ifdef DEAL_II_WITH_HDF5
+    // All processes write collectively (through MPI-IO) into a single file
+    // per time step. The mesh is written only once, and one XDMF file indexes
+    // the whole time series. Unlike the VTU output, the files are written
+    // synchronously: collective writes on MPI_COMM_WORLD cannot run on a
+    // background thread while the time loop communicates on it.
+    DataOutBase::DataOutFilter data_filter(
+        DataOutBase::DataOutFilterFlags(true, true));
+    data_out->write_filtered_data(data_filter);
+
+    const bool write_mesh = hdf5_mesh_file_name.empty();
+    if (write_mesh)
+      hdf5_mesh_file_name =
+          output_file_name + "-mesh" +
+          (time_step > 0 ? "_" + std::to_string(time_step) : "") + ".h5";
+
+    const std::string solution_file_name_h5 =
+        output_file_name + "_" + std::to_string(time_step) + ".h5";
+
+    data_out->write_hdf5_parallel(data_filter,
+                                  write_mesh,
+                                  hdf5_mesh_file_name,
+                                  solution_file_name_h5,
+                                  MPI_COMM_WORLD);
+
+    // The files are written collectively: only rank 0 counts their size.
+    if (mpi_rank == 0)
+      profiler.add("bytes written",
+                   std::ifstream(solution_file_name_h5,
+                                 std::ios::binary | std::ios::ate)
+                       .tellg());
+
+    xdmf_entries.push_back(data_out->create_xdmf_entry(data_filter,
+                                                       hdf5_mesh_file_name,
+                                                       solution_file_name_h5,
+                                                       time,
+                                                       MPI_COMM_WORLD));
+    data_out->write_xdmf_file(xdmf_entries,
+                              output_file_name + ".xdmf",
+                              MPI_COMM_WORLD);
+
+    pcout << "Output written to " << solution_file_name_h5 << std::endl;
+    pcout << "===============================================" << std::endl;
+    return;
+#else
+    AssertThrow(false,
+                ExcMessage("HDF5 output requires deal.II built with HDF5."));
+#endif
+  }
+
+  // Only one write is in flight at any time.
+  wait_for_output();
+
+  // Same file names as DataOut::write_vtu_with_pvtu_record(). The record is
+  // written right away by rank 0, while each process writes its own piece in
+  // the background, overlapping file I/O with the next time step.
+  const unsigned int n_digits_rank = Utilities::needed_digits(mpi_size - 1);
+  const std::string file_name_prefix =
+      "./" + output_file_name + "_" + std::to_string(time_step);
+
+  if (mpi_rank == 0)
+  {
+    std::vector<std::string> piece_names;
+    for (unsigned int rank = 0; rank < mpi_size; ++rank)
+      piece_names.push_back(output_file_name + "_" +
+                            std::to_string(time_step) + "." +
+                            Utilities::int_to_string(rank, n_digits_rank) +
+                            ".vtu");
+
+    std::ofstream pvtu_file(file_name_prefix + ".pvtu");
+    data_out->write_pvtu_record(pvtu_file, piece_names);
+    profiler.add("bytes written", pvtu_file.tellp());
+  }
+
+  const std::string piece_file_name =
+      file_name_prefix + "." + Utilities::int_to_string(mpi_rank, n_digits_rank) +
+      ".vtu";
+
+  output_task = std::async(std::launch::async,
+                           [data_out, partitioning, piece_file_name]()
+                           {
+                             std::ofstream vtu_file(piece_file_name);
+                             data_out->write_vtu(vtu_file);
+                             return static_cast<std::size_t>(vtu_file.tellp());
+                           });
+
+  pcout << "Output queued to " << output_file_name << std::endl;
+  pcout << "===============================================" << std::endl;
+}
+
+template <int dim>
+void NavierStokes<dim>::wait_for_output() const
+{
+  // The background task cannot update the profiler itself, since it runs
+  // concurrently with the time loop.
+  if (output_task.valid())
+    profiler.add("bytes written", output_task.get());
+}
+
+template <int dim>
+void NavierStokes<dim>::Profiler::enter(const std::string &name)
+{
+  const std::string path =
+      open_sections.empty() ? name : open_sections.back().first + "/" + name;
+  open_sections.emplace_back(path, std::chrono::steady_clock::now());
+}
+
+template <int dim>
+void NavierStokes<dim>::Profiler::leave()
+{
+  Assert(!open_sections.empty(), ExcMessage("No section to leave."));
+
+  const auto &[path, start] = open_sections.back();
+  Section &section = sections[path];
+  ++section.calls;
+  section.wall_time +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  open_sections.pop_back();
+}
+
+template <int dim>
+void NavierStokes<dim>::Profiler::write_summary(const std::string &prefix,
+                                                ConditionalOStream &pcout) const
+{
+  // Sections and counters may exist only on some processes (e.g. the mesh is
+  // read by one process per group): all processes take part in the
+  // reductions of the union of their names, with zero where absent.
+  const auto all_names = [](const auto &map)
+  {
+    std::vector<std::string> names;
+    for (const auto &entry : map)
+      names.push_back(entry.first);
+
+    std::set<std::string> union_names;
+    for (const auto &names_rank : Utilities::MPI::all_gather(MPI_COMM_WORLD, names))
+      union_names.insert(names_rank.begin(), names_rank.end());
+    return union_names;
+  };
+
+  const unsigned int mpi_rank = Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+  const unsigned int mpi_size = Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
+
+  std::ofstream json_file;
+  std::ofstream csv_file;
+  if (mpi_rank == 0)
+  {
+    json_file.open(prefix + ".json");
+    csv_file.open(prefix + ".csv");
+
+    json_file << "{\n  \"n_processes\": " << mpi_size << ",\n  \"sections\": [";
+    csv_file << "TYPE,NAME,CALLS,MIN,MAX,AVG,SUM" << std::endl;
+  }
+
+  pcout << "===============================================" << std::endl;
+  pcout << "Wall time [s] over " << mpi_size << " process(es)" << std::endl;
+  pcout << std::left << std::setw(50) << "  Section" << std::right
+        << std::setw(8) << "Calls" << std::setw(12) << "Min"
+        << std::setw(12) << "Max" << std::setw(12) << "Avg" << std::endl;
+
+  bool first = true;
+  for (const std::string &name : all_names(sections))
+  {
+    const auto it = sections.find(name);
+    const Section section = it != sections.end() ? it->second : Section();
+
+    const unsigned long long calls =
+        Utilities::MPI::max(section.calls, MPI_COMM_WORLD);
+    const Utilities::MPI::MinMaxAvg time =
+        Utilities::MPI::min_max_avg(section.wall_time, MPI_COMM_WORLD);
+
+    // Nested sections are indented by their depth.
+    const std::size_t depth = std::count(name.begin(), name.end(), '/');
+    const std::string label = std::string(2 * depth + 2, ' ') +
+                              name.substr(name.find_last_of('/') + 1);
+
+    pcout << std::left << std::setw(50) << label << std::right
+          << std::setw(8) << calls << std::setw(12) << time.min
+          << std::setw(12) << time.max << std::setw(12) << time.avg
+          << std::endl;
+
+    if (mpi_rank == 0)
+    {
+      json_file << (first ? "" : ",") << "\n    {\"name\": \"" << name
+                << "\", \"calls\": " << calls << ", \"min\": " << time.min
+                << ", \"max\": " << time.max << ", \"avg\": " << time.avg
+                << "}";
+      csv_file << "section," << name << "," << calls << "," << time.min << ","
+               << time.max << "," << time.avg << "," << time.sum << std::endl;
+    }
+    first = false;
+  }
+
+  if (mpi_rank == 0)
+    json_file << "\n  ],\n  \"counters\": [";
+
+  pcout << "Counters" << std::endl;
+  pcout << std::left << std::setw(50) << "  Counter" << std::right
+        << std::setw(14) << "Sum" << std::setw(14) << "Min" << std::setw(14)
+        << "Max" << std::setw(14) << "Avg" << std::endl;
+
+  first = true;
+  for (const std::string &name : all_names(counters))
+  {
+    const auto it = counters.find(name);
+    const Utilities::MPI::MinMaxAvg value = Utilities::MPI::min_max_avg(
+        it != counters.end() ? it->second : 0.0, MPI_COMM_WORLD);
+
+    pcout << std::left << std::setw(50) << "  " + name << std::right
+          << std::setw(14) << value.sum << std::setw(14) << value.min
+          << std::setw(14) << value.max << std::setw(14) << value.avg
+          << std::endl;
+
+    if (mpi_rank == 0)
+    {
+      json_file << (first ? "" : ",") << "\n    {\"name\": \"" << name
+                << "\", \"sum\": " << value.sum << ", \"min\": "
+                << value.min << ", \"max\": " << value.max
+                << ", \"avg\": " << value.avg << "}";
+      csv_file << "counter," << name << ",," << value.min << "," << value.max
+               << "," << value.avg << "," << value.sum << std::endl;
+    }
+    first = false;
+  }
+
+  if (mpi_rank == 0)
+    json_file << "\n  ]\n}" << std::endl;
+
+  pcout << "Summary written to " << prefix << ".json and " << prefix << ".csv"
+        << std::endl;
+  pcout << "===============================================" << std::endl;
+}
+
+//
+template <int dim>
+void NavierStokes<dim>::solve()
+{
+
+  pcout << "===============================================" << std::endl;
+
+  unsigned int time_step = 0;
+  double time = 0;
+
+  profiler.enter("time loop");
+
+  // Restart from the last checkpoint, if requested and available.
+  if (restart && read_checkpoint(time_step, time))
+  {
+    pcout << "===============================================" << std::endl;
+  }
+  // Otherwise, apply the initial condition.
+  else
+  {
+    pcout << "Applying the initial condition" << std::endl;
+
+    VectorTools::interpolate(dof_handler, u_0, solution_owned);
+    solution = solution_owned;
+
+    // Output the initial solution.
+    Profiler::Scope scope(profiler, "output");
+    output(0, 0.0);
+    pcout << "===============================================" << std::endl;
+  }
+
+  last_checkpoint_time = std::chrono::steady_clock::now();
+
+  solution_history.add(time, solution_owned);
+
+  // Number of rejected attempts at the current time step.
+  unsigned int n_rejected = 0;
+
+  while (time < T)
+  {
+    // Solution at the previous time step, restored if the step is rejected.
+    TrilinosWrappers::MPI::BlockVector solution_old;
+    if (adaptive_time_step)
+      solution_old = solution_owned;
+
+    // The volume formulation of the forces needs the time derivative.
+    if (force_method == ForceMethod::Volume)
+      solution_previous = solution_owned;
+
+    time += deltat;
+    ++time_step;
+
+    pcout << "n = " << std::setw(3) << time_step << ", t = " << std::setw(5)
+          << time << ":" << std::flush;
+
+    assemble(time);
+
+    bool converged = true;
+    if (!adaptive_time_step)
+      solve_time_step();
+    else
+    {
+      try
+      {
+        solve_time_step();
+      }
+      catch (const SolverControl::NoConvergence &)
+      {
+        converged = false;
+      }
+    }
+
+    // CFL number of the step, used to adapt the time step.
+    double cfl = 0.0;
+
+    if (adaptive_time_step)
+    {
+      if (converged)
+      {
+        Profiler::Scope scope(profiler, "cfl");
+        cfl = compute_cfl();
+      }
+      pcout << "  CFL number: " << cfl << std::endl;
+
+      // Reject the step if it did not converge or if the CFL number is too
+      // large, unless the time step is already the smallest allowed.
+      if ((!converged || cfl > 1.5 * cfl_target) && deltat > deltat_min)
+      {
+        pcout << "  Step rejected, repeating it with a smaller time step"
+              << std::endl;
+
+        time -= deltat;
+        --time_step;
+        ++n_rejected;
+
+        solution_owned = solution_old;
+        solution = solution_owned;
+
+        // Discard the statistics of the rejected attempt.
+        const unsigned int n_steps = vec_drag_coeff.size();
+        time_assemble.resize(n_steps);
+        time_prec.resize(n_steps);
+        time_solve.resize(n_steps);
+        gmres_iterations.resize(n_steps);
+        inner_iterations.resize(n_steps);
+        preconditioner_rebuilt.resize(n_steps);
+
+        set_time_step(std::max(deltat_min,
+                               converged ? 0.9 * deltat * cfl_target / cfl
+                                         : 0.5 * deltat));
+        continue;
+      }
+
+      AssertThrow(converged,
+                  ExcMessage("The linear solver did not converge with the "
+                             "smallest allowed time step."));
+    }
+
+    solution_history.add(time, solution_owned);
+
+    time_values.emplace_back(time);
+    deltat_values.emplace_back(deltat);
+    rejected_steps.emplace_back(n_rejected);
+    n_rejected = 0;
+
+    if (adaptive_time_step)
+    {
+      // Grow the time step towards the target CFL number, at most doubling
+      // it. Small changes are ignored, since every change of the time step
+      // requires reassembling the constant matrix and the preconditioner.
+      const double deltat_new =
+          std::min({deltat_max,
+                    2.0 * deltat,
+                    cfl > 0.0 ? deltat * cfl_target / cfl : deltat_max});
+      if (deltat_new > 1.2 * deltat || deltat_new < deltat)
+        set_time_step(std::max(deltat_min, deltat_new));
+    }
+
+    {
+      Profiler::Scope scope(profiler, "forces");
+      compute_forces();
+    }
+
+    const auto t0_o = std::chrono::high_resolution_clock::now();
+
+    if (output_due(time_step, time))
+    {
+      Profiler::Scope scope(profiler, "output");
+      output(time_step, time);
+    }
+
+    const auto t1_o = std::chrono::high_resolution_clock::now();
+    time_output.emplace_back(std::chrono::duration_cast<std::chrono::milliseconds>(t1_o - t0_o).count());
+
+    // Checkpoints are written at regular intervals of wall time. The slowest
+    // process decides, so that all processes agree.
+    if (checkpoint_interval > 0.0)
+    {
+      const double elapsed = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() -
+                                 last_checkpoint_time)
+                                 .count();
+      if (Utilities::MPI::max(elapsed, MPI_COMM_WORLD) >= checkpoint_interval)
+        write_checkpoint(time_step, time);
+    }
+  }
+
+  profiler.leave();
+
+  wait_for_output();
+
+  profiler.write_summary("profile_" + std::to_string(dim) + "D", pcout);
+}
+
+template <int dim>
+std::vector<std::pair<types::global_dof_index, typename NavierStokes<dim>::CheckpointKey>>
+NavierStokes<dim>::checkpoint_keys() const
+{
+  // Each DoF is identified by its vector component and by the coordinates of
+  // its support point, which do not depend on the partitioning of the mesh.
+  const MappingFE<dim> mapping(FE_SimplexP<dim>(1));
+
+  std::vector<std::pair<types::global_dof_index, CheckpointKey>> keys;
+  for (unsigned int c = 0; c < dim + 1; ++c)
+  {
+    ComponentMask mask(dim + 1, false);
+    mask.set(c, true);
+
+    std::map<types::global_dof_index, Point<dim>> support_points;
+    DoFTools::map_dofs_to_support_points(mapping,
+                                         dof_handler,
+                                         support_points,
+                                         mask);
+
+    for (const auto &support_point : support_points)
+    {
+      if (!locally_owned_dofs.is_element(support_point.first))
+        continue;
+
+      CheckpointKey key;
+      key[0] = c;
+      for (unsigned int d = 0; d < dim; ++d)
+        key[d + 1] = std::llround(support_point.second[d] * 1e8);
+      keys.emplace_back(support_point.first, key);
+    }
+  }
+
+  return keys;
+}
+
+template <int dim>
+std::string
+NavierStokes<dim>::checkpoint_data_file_name(const unsigned int &time_step,
+                                             const unsigned int &rank) const
+{
+  return checkpoint_prefix + "." + std::to_string(time_step) + "." +
+         std::to_string(rank) + ".data";
+}
+
+template <int dim>
+void NavierStokes<dim>::write_checkpoint(const unsigned int &time_step,
+                                    const double &time)
+{
+  Profiler::Scope scope(profiler, "checkpoint");
+
+  pcout << "Writing checkpoint " << checkpoint_prefix << " at t = " << time
+        << std::endl;
+
+  // Every process writes the values of its own DoFs, together with their
+  // keys, so that the checkpoint can be read back on any number of processes.
+  // The data files of each checkpoint are named after its time step, so they
+  // never overwrite those of the previous checkpoint. The info file, which
+  // records that time step, is written last under a temporary name and
+  // renamed once complete: the rename is the only point where the new
+  // checkpoint replaces the previous one.
+  {
+    std::ofstream data_file(checkpoint_data_file_name(time_step, mpi_rank),
+                            std::ios::binary);
+    for (const auto &[dof, key] : checkpoint_keys())
+    {
+      const double value = solution_owned(dof);
+      data_file.write(reinterpret_cast<const char *>(key.data()),
+                      sizeof(CheckpointKey));
+      data_file.write(reinterpret_cast<const char *>(&value), sizeof(double));
+    }
+    profiler.add("bytes written", data_file.tellp());
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  if (mpi_rank == 0)
+  {
+    const std::string info_file_name = checkpoint_prefix + ".info";
+    {
+      std::ofstream info_file(info_file_name + ".tmp", std::ios::binary);
+      boost::archive::binary_oarchive archive(info_file);
+      archive << mpi_size << time_step << time << deltat << next_output_time;
+      archive << vec_drag << vec_lift << vec_drag_coeff << vec_lift_coeff
+              << time_assemble << time_prec << time_solve << time_output
+              << gmres_iterations << inner_iterations << preconditioner_rebuilt
+              << time_values << deltat_values << rejected_steps;
+      archive << xdmf_entries;
+    }
+    std::rename((info_file_name + ".tmp").c_str(), info_file_name.c_str());
+    profiler.add("bytes written",
+                 std::ifstream(info_file_name, std::ios::binary | std::ios::ate)
+                     .tellg());
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // The previous checkpoint is no longer needed. Its files may have been
+  // written by a different number of processes, and are shared among the
+  // current ones.
+  if (last_checkpoint_step != numbers::invalid_unsigned_int &&
+      last_checkpoint_step != time_step)
+    for (unsigned int rank = mpi_rank; rank < last_checkpoint_mpi_size;
+         rank += mpi_size)
+      std::remove(
+          checkpoint_data_file_name(last_checkpoint_step, rank).c_str());
+
+  last_checkpoint_step = time_step;
+  last_checkpoint_mpi_size = mpi_size;
+
+  last_checkpoint_time = std::chrono::steady_clock::now();
+}
+
+template <int dim>
+bool NavierStokes<dim>::read_checkpoint(unsigned int &time_step, double &time)
+{
+  const std::string info_file_name = checkpoint_prefix + ".info";
+
+  if (!std::ifstream(info_file_name).good())
+    return false;
+
+  Profiler::Scope scope(profiler, "checkpoint");
+
+  pcout << "Restarting from checkpoint " << checkpoint_prefix << std::endl;
+
+  unsigned int checkpoint_mpi_size;
+  double checkpoint_deltat;
+  {
+    std::ifstream info_file(info_file_name, std::ios::binary);
+    boost::archive::binary_iarchive archive(info_file);
+    archive >> checkpoint_mpi_size >> time_step >> time >> checkpoint_deltat >>
+        next_output_time;
+    archive >> vec_drag >> vec_lift >> vec_drag_coeff >> vec_lift_coeff
+            >> time_assemble >> time_prec >> time_solve >> time_output
+            >> gmres_iterations >> inner_iterations >> preconditioner_rebuilt
+            >> time_values >> deltat_values >> rejected_steps;
+    archive >> xdmf_entries;
+  }
+
+  last_checkpoint_step = time_step;
+  last_checkpoint_mpi_size = checkpoint_mpi_size;
+
+  // Read the files of all the processes that wrote the checkpoint, keeping
+  // only the values of the DoFs owned by this process.
+  const auto keys = checkpoint_keys();
+  std::map<CheckpointKey, double> values;
+  for (const auto &[dof, key] : keys)
+    values[key] = 0.0;
+
+  // Bounding box of the owned support points, in rounded coordinates, used
+  // to discard most of the values of the other processes at once.
+  CheckpointKey key_min, key_max;
+  key_min.fill(std::numeric_limits<long long>::max());
+  key_max.fill(std::numeric_limits<long long>::min());
+  for (const auto &[dof, key] : keys)
+    for (unsigned int d = 1; d <= dim; ++d)
+    {
+      key_min[d] = std::min(key_min[d], key[d]);
+      key_max[d] = std::max(key_max[d], key[d]);
+    }
+
+  // The coordinates are rounded independently by the process that wrote a
+  // value and by the one reading it, so the same support point may get keys
+  // differing by one unit in some coordinate. A value is therefore matched
+  // to the owned key equal to its own, or else to one of its neighbours:
+  // distinct support points are much farther apart than the rounding unit,
+  // so the match is unique.
+  const auto find_owned = [&](const CheckpointKey &key)
+  {
+    for (unsigned int d = 1; d <= dim; ++d)
+      if (key[d] < key_min[d] - 1 || key[d] > key_max[d] + 1)
+        return values.end();
+
+    auto it = values.find(key);
+    for (unsigned int n = 0;
+         it == values.end() && n < Utilities::pow(3u, dim);
+         ++n)
+    {
+      CheckpointKey neighbour = key;
+      for (unsigned int d = 1, m = n; d <= dim; ++d, m /= 3)
+        neighbour[d] += static_cast<long long>(m % 3) - 1;
+      it = values.find(neighbour);
+    }
+    return it;
+  };
+
+  unsigned int n_found = 0;
+  for (unsigned int rank = 0; rank < checkpoint_mpi_size; ++rank)
+  {
+    std::ifstream data_file(checkpoint_data_file_name(time_step, rank),
+                            std::ios::binary);
+
+    CheckpointKey key;
+    double value;
+    while (data_file.read(reinterpret_cast<char *>(key.data()),
+                          sizeof(CheckpointKey)) &&
+           data_file.read(reinterpret_cast<char *>(&value), sizeof(double)))
+    {
+      const auto it = find_owned(key);
+      if (it != values.end())
+      {
+        it->second = value;
+        ++n_found;
+      }
+    }
+  }
+
+  AssertThrow(Utilities::MPI::min(n_found == keys.size() ? 1u : 0u,
+                                  MPI_COMM_WORLD) == 1,
+              ExcMessage("The checkpoint does not match the current mesh."));
+
+  for (const auto &[dof, key] : keys)
+    solution_owned(dof) = values[key];
+  solution_owned.compress(VectorOperation::insert);
+  solution = solution_owned;
+
+  // Continue with the time step in use when the checkpoint was written.
+  set_time_step(checkpoint_deltat);
+
+  pcout << "  Restarting at n = " << time_step << ", t = " << time
+        << " (checkpoint written on " << checkpoint_mpi_size
+        << " processes)" << std::endl;
+
+  return true;
+}
+
+template <int dim>
+double NavierStokes<dim>::compute_cfl() const
+{
+  FEValues<dim> fe_values(*fe, *quadrature, update_values);
+  FEValuesExtractors::Vector velocity(0);
+  std::vector<Tensor<1, dim>> velocity_values(quadrature->size());
+
+  double cfl = 0.0;
+  for (const auto &cell : dof_handler.active_cell_iterators())
+  {
+    if (!cell->is_locally_owned())
+      continue;
+
+    fe_values.reinit(cell);
+    fe_values[velocity].get_function_values(solution, velocity_values);
+
+    double max_velocity = 0.0;
+    for (const auto &u : velocity_values)
+      max_velocity = std::max(max_velocity, u.norm());
+
+    cfl = std::max(cfl,
+                   max_velocity * deltat * degree_velocity / cell->diameter());
+  }
+
+  return Utilities::MPI::max(cfl, MPI_COMM_WORLD);
+}
+
+template <int dim>
+void NavierStokes<dim>::set_time_step(const double &deltat_)
+{
+  if (deltat_ == deltat)
+    return;
+
+  pcout << "  Time step changed from " << deltat << " to " << deltat_
+        << std::endl;
+
+  deltat = deltat_;
+
+  // The time derivative is part of the constant matrix, and the
+  // preconditioner was built for the old time step. In matrix-free mode the
+  // time step is passed to the OseenOperator by assemble().
+  if (!matrix_free)
+    assemble_constant();
+  preconditioner_age = numbers::invalid_unsigned_int;
+}
+
+template <int dim>
+bool NavierStokes<dim>::output_due(const unsigned int &time_step, const double &time)
+{
+  // Based on the simulated time, if an output time interval is set.
+  if (output_time_interval > 0.0)
+  {
+    if (time < next_output_time - 1e-10 * deltat)
+      return false;
+
+    while (next_output_time <= time + 1e-10 * deltat)
+      next_output_time += output_time_interval;
+    return true;
+  }
+
+  // Otherwise, based on the number of time steps.
+  return time_step % output_interval == 0;
+}
+
+template <int dim>
+void NavierStokes<dim>::compute_forces()
+{
+  pcout << "===============================================" << std::endl;
+  pcout << "Computing forces: " << std::endl;
+
+	double drag=0.;
+	double lift=0.;
+
+  double local_lift = 0.0;
+  double local_drag = 0.0;
+
+  const double lift_sign = dim == 2 ? 1.0 : -1.0;
+
+  FEValuesExtractors::Vector velocity(0);
+  FEValuesExtractors::Scalar pressure(dim);
+
+  // The surface integral is cheap, since it only visits the faces of the
+  // obstacle: it is evaluated with both methods, and with the volume one it
+  // is printed next to the volume result as a check.
+  {
+    const unsigned int n_q_face = quadrature_face->size();
+
+    // The solution is only needed on the faces of the obstacle, and is
+    // evaluated there into buffers allocated once.
+    FEFaceValues<dim> fe_face_values(*fe,
+                                     *quadrature_face,
+                                     update_values | update_gradients |
+                                         update_normal_vectors |
+                                         update_JxW_values);
+
+    std::vector<double> current_pressure_values(n_q_face);
+    std::vector<Tensor<2, dim>> current_velocity_gradients(n_q_face);
+
+    for (const auto &[cell, f] : obstacle_faces)
+    {
+      fe_face_values.reinit(cell, f);
+      fe_face_values[pressure].get_function_values(solution,
+                                                   current_pressure_values);
+      fe_face_values[velocity].get_function_gradients(
+          solution, current_velocity_gradients);
+
+      for (unsigned int q = 0; q < n_q_face; ++q)
+      {
+        // Get the values
+        const double nx = fe_face_values.normal_vector(q)[0];
+        const double ny = fe_face_values.normal_vector(q)[1];
+
+        // Construct the tensor (in the xy plane also in 3D).
+        Tensor<1, dim> tangent;
+        tangent[0] = ny;
+        tangent[1] = -nx;
+
+        local_drag += (rho * nu * fe_face_values.normal_vector(q) * current_velocity_gradients[q] * // This is the tangential component
+					( tangent / tangent.norm_square() )
+					* ny 
+					-
+					current_pressure_values[q] * nx
+					)*fe_face_values.JxW(q);
+
+        // The 3D lift is taken with the opposite orientation.
+        local_lift += lift_sign * (rho * nu * fe_face_values.normal_vector(q) * current_velocity_gradients[q] * // This is the tangential components
+					( tangent / tangent.norm_square() )
+					* nx 
+					+
+          current_pressure_values[q] * ny
+					)*fe_face_values.JxW(q);
+      }
+    }
+  }
+
+  double surface_drag = 0.0;
+  double surface_lift = 0.0;
+
+  if (force_method == ForceMethod::Volume)
+  {
+    surface_drag = Utilities::MPI::sum(local_drag, MPI_COMM_WORLD);
+    surface_lift = Utilities::MPI::sum(local_lift, MPI_COMM_WORLD);
+
+    // Volume (weak residual) formulation: the force is the residual of the
+    // momentum equation tested with a function v equal to e_x (for the drag)
+    // or e_y (for the lift) on the obstacle and zero on the other DoFs, i.e.
+    // the sum of the residuals of the obstacle DoFs. Since the residual is
+    // integrated over the cells around the obstacle, no derivatives are
+    // evaluated on the boundary, which is more accurate on coarse meshes.
+    // With the same orientation as above, the drag is the x component and
+    // the lift the y component with the opposite sign.
+    const unsigned int n_q = quadrature->size();
+    const double step_deltat = deltat_values.back();
+
+    FEValues<dim> fe_values(*fe,
+                            *quadrature,
+                            update_values | update_gradients |
+                                update_JxW_values);
+
+    std::vector<Tensor<1, dim>> current_velocity_values(n_q);
+    std::vector<Tensor<1, dim>> previous_velocity_values(n_q);
+    std::vector<Tensor<2, dim>> current_velocity_gradients(n_q);
+    std::vector<double> current_pressure_values(n_q);
+    std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+
+    Tensor<1, dim> local_residual;
+
+    for (const auto &cell : obstacle_cells)
+    {
+      fe_values.reinit(cell);
+      cell->get_dof_indices(dof_indices);
+
+      fe_values[velocity].get_function_values(solution, current_velocity_values);
+      fe_values[velocity].get_function_values(solution_previous,
+                                              previous_velocity_values);
+      fe_values[velocity].get_function_gradients(solution,
+                                                 current_velocity_gradients);
+      fe_values[pressure].get_function_values(solution, current_pressure_values);
+
+      for (unsigned int q = 0; q < n_q; ++q)
+      {
+        const Tensor<1, dim> &u = current_velocity_values[q];
+        const Tensor<1, dim> &u_old = previous_velocity_values[q];
+        const Tensor<2, dim> &grad_u = current_velocity_gradients[q];
+        const double p = current_pressure_values[q];
+
+        // Same discretization as the system: the convective velocity is the
+        // one of the previous time step, and the convective term is the same
+        // contraction u_old * grad(u) as in the assembly.
+        const Tensor<1, dim> convection = u_old * grad_u;
+
+        for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+        {
+          const unsigned int c = fe->system_to_component_index(i).first;
+          if (c >= dim || !obstacle_dofs.is_element(dof_indices[i]))
+            continue;
+
+          const double phi_i = fe_values.shape_value(i, q);
+          const Tensor<1, dim> grad_phi_i = fe_values.shape_grad(i, q);
+
+          local_residual[c] +=
+              (rho * ((u[c] - u_old[c]) / step_deltat + convection[c]) *
+                   phi_i +
+               rho * nu * (grad_u[c] * grad_phi_i) - p * grad_phi_i[c]) *
+              fe_values.JxW(q);
+        }
+      }
+    }
+
+    local_drag = local_residual[0];
+    local_lift = -lift_sign * local_residual[1];
+  }
+
+  drag = Utilities::MPI::sum(local_drag, MPI_COMM_WORLD);
+  lift = Utilities::MPI::sum(local_lift, MPI_COMM_WORLD);
+  pcout << "Drag :\t " << drag << " Lift :\t " << lift << std::endl;
+  // The mean velocity is defined as 2U(0,H/2,t)/3 in the 2D-2 unsteady case,
+  // and as 4U(0,H/2,H/2,t)/9 in 3D.
+  const double mean_v = inlet_velocity.getMeanVelocity();
+	const double D= 0.1;
+	const double H=0.41;
+
+  // Reference area of the drag and lift coefficients.
+  const double reference_area = dim == 2 ? M_PI * D : D * H;
+
+	const double c_d=(2.*drag)/(rho*mean_v*mean_v*reference_area);
+	const double c_l=(2.*lift)/(rho*mean_v*mean_v*reference_area);
+
+	pcout << "Coeff:\t " << c_d << " Coeff:\t " << c_l << std::endl;
+
+  // The two methods converge to the same coefficients as the mesh is refined;
+  // on the benchmark meshes they should agree to a few percent.
+  if (force_method == ForceMethod::Volume)
+  {
+    const double surface_c_d =
+        (2. * surface_drag) / (rho * mean_v * mean_v * reference_area);
+    const double surface_c_l =
+        (2. * surface_lift) / (rho * mean_v * mean_v * reference_area);
+
+    pcout << "Surface coeff:\t " << surface_c_d << " Surface coeff:\t "
+          << surface_c_l << std::endl;
+    pcout << "Volume - surface:\t " << c_d - surface_c_d << " \t "
+          << c_l - surface_c_l << std::endl;
+  }
+
+  vec_drag.emplace_back(drag);
+  vec_lift.emplace_back(lift);
+	vec_drag_coeff.emplace_back(c_d);
+	vec_lift_coeff.emplace_back(c_l);
+
+  pcout << "===============================================" << std::endl;
+}
+
+template <int dim>
+void NavierStokes<dim>::assemble_pcd()
+{
+  pcout << "  Assembling the PCD matrices" << std::endl;
+
+  pressure_laplacian = 0.0;
+  pressure_convection_diffusion = 0.0;
+
+  FEValues<dim> fe_values(*fe,
+                          *quadrature,
+                          update_values | update_gradients | update_JxW_values);
+  FEFaceValues<dim> fe_face_values(*fe,
+                                   *quadrature_face,
+                                   update_values | update_normal_vectors |
+                                       update_JxW_values);
+
+  const FEValuesExtractors::Vector velocity(0);
+
+  // Local indices of the pressure shape functions: the matrices are only
+  // assembled on the pressure DoFs.
+  std::vector<unsigned int> pressure_local_dofs;
+  for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+    if (fe->system_to_component_index(i).first == dim)
+      pressure_local_dofs.push_back(i);
+  const unsigned int n_p_cell = pressure_local_dofs.size();
+
+  FullMatrix<double> cell_laplacian(n_p_cell, n_p_cell);
+  FullMatrix<double> cell_convection_diffusion(n_p_cell, n_p_cell);
+
+  std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+  std::vector<types::global_dof_index> pressure_dof_indices(n_p_cell);
+
+  std::vector<Tensor<1, dim>> velocity_values(quadrature->size());
+  std::vector<Tensor<1, dim>> face_velocity_values(quadrature_face->size());
+
+  for (const auto &cell : dof_handler.active_cell_iterators())
+  {
+    if (!cell->is_locally_owned())
+      continue;
+
+    fe_values.reinit(cell);
+    fe_values[velocity].get_function_values(solution, velocity_values);
+
+    cell_laplacian = 0.0;
+    cell_convection_diffusion = 0.0;
+
+    // Same terms as the velocity block F: time derivative, viscosity and
+    // convection by the velocity of the previous time step.
+    for (unsigned int q = 0; q < quadrature->size(); ++q)
+    {
+      const double JxW = fe_values.JxW(q);
+
+      for (unsigned int i = 0; i < n_p_cell; ++i)
+      {
+        const unsigned int k = pressure_local_dofs[i];
+        for (unsigned int j = 0; j < n_p_cell; ++j)
+        {
+          const unsigned int l = pressure_local_dofs[j];
+          const double laplacian =
+              fe_values.shape_grad(k, q) * fe_values.shape_grad(l, q) * JxW;
+
+          cell_laplacian(i, j) += laplacian;
+          cell_convection_diffusion(i, j) +=
+              nu * laplacian +
+              (fe_values.shape_value(k, q) * fe_values.shape_value(l, q) /
+                   deltat +
+               velocity_values[q] * fe_values.shape_grad(l, q) *
+                   fe_values.shape_value(k, q)) *
+                  JxW;
+        }
+      }
+    }
+
+    // Robin condition on the inlet, where the velocity enters the domain.
+    if (cell->at_boundary())
+      for (unsigned int f = 0; f < cell->n_faces(); ++f)
+      {
+        if (!cell->face(f)->at_boundary() ||
+            cell->face(f)->boundary_id() != inlet_id)
+          continue;
+
+        fe_face_values.reinit(cell, f);
+        fe_face_values[velocity].get_function_values(solution,
+                                                     face_velocity_values);
+
+        for (unsigned int q = 0; q < quadrature_face->size(); ++q)
+        {
+          const double w_n = face_velocity_values[q] *
+                             fe_face_values.normal_vector(q) *
+                             fe_face_values.JxW(q);
+          for (unsigned int i = 0; i < n_p_cell; ++i)
+            for (unsigned int j = 0; j < n_p_cell; ++j)
+              cell_convection_diffusion(i, j) -=
+                  w_n *
+                  fe_face_values.shape_value(pressure_local_dofs[i], q) *
+                  fe_face_values.shape_value(pressure_local_dofs[j], q);
+        }
+      }
+
+    cell->get_dof_indices(dof_indices);
+    for (unsigned int i = 0; i < n_p_cell; ++i)
+      pressure_dof_indices[i] = dof_indices[pressure_local_dofs[i]];
+
+    pcd_constraints.distribute_local_to_global(cell_laplacian,
+                                               pressure_dof_indices,
+                                               pressure_laplacian);
+    pcd_constraints.distribute_local_to_global(cell_convection_diffusion,
+                                               pressure_dof_indices,
+                                               pressure_convection_diffusion);
+  }
+
+  pressure_laplacian.compress(VectorOperation::add);
+  pressure_convection_diffusion.compress(VectorOperation::add);
+}
+
+template <int dim>
+void NavierStokes<dim>::assemble_lumped_velocity_mass()
+{
+  pcout << "  Assembling the lumped velocity mass matrix" << std::endl;
+
+  // The velocity DoFs come first, so that their global indices are also
+  // their indices in the velocity block.
+  velocity_lumped_mass.reinit(block_owned_dofs[0], MPI_COMM_WORLD);
+
+  FEValues<dim> fe_values(*fe, *quadrature, update_values | update_JxW_values);
+
+  std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+  std::vector<types::global_dof_index> velocity_dof_indices;
+  std::vector<double> cell_lumped_mass;
+  std::vector<double> cell_diagonal(fe->dofs_per_cell);
+
+  for (const auto &cell : dof_handler.active_cell_iterators())
+  {
+    if (!cell->is_locally_owned())
+      continue;
+
+    fe_values.reinit(cell);
+
+    // Row sums of the mass matrix vanish (or are negative) at the vertices of
+    // quadratic simplices. The diagonal is scaled instead, so that each
+    // velocity component keeps the measure of the cell (HRZ lumping).
+    double measure = 0.0;
+    std::vector<double> diagonal_sum(dim, 0.0);
+    for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+      cell_diagonal[i] = 0.0;
+
+    for (unsigned int q = 0; q < quadrature->size(); ++q)
+    {
+      measure += fe_values.JxW(q);
+      for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+        cell_diagonal[i] += fe_values.shape_value(i, q) *
+                            fe_values.shape_value(i, q) * fe_values.JxW(q);
+    }
+
+    for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+    {
+      const unsigned int component = fe->system_to_component_index(i).first;
+      if (component < dim)
+        diagonal_sum[component] += cell_diagonal[i];
+    }
+
+    cell->get_dof_indices(dof_indices);
+    velocity_dof_indices.clear();
+    cell_lumped_mass.clear();
+    for (unsigned int i = 0; i < fe->dofs_per_cell; ++i)
+    {
+      const unsigned int component = fe->system_to_component_index(i).first;
+      if (component >= dim)
+        continue;
+
+      velocity_dof_indices.push_back(dof_indices[i]);
+      cell_lumped_mass.push_back(cell_diagonal[i] * measure /
+                                 diagonal_sum[component]);
+    }
+
+    velocity_lumped_mass.add(velocity_dof_indices, cell_lumped_mass);
+  }
+
+  velocity_lumped_mass.compress(VectorOperation::add);
+}
+
+template <int dim>
+void NavierStokes<dim>::output_results() const
+{
+
+	// The history is the same on all processes.
+	if (mpi_rank != 0)
+		return;
+
+	std::ofstream results("results_" + std::to_string(dim) + "D.csv");
+
+	results<<"N,TIME,DT,REJECTED,T_ASSEMBLE,T_PREC,T_SOLV,T_OUTPUT,ITER,INNER_ITER,PREC_REBUILT,DRAG,LIFT,DRAG_C,LIFT_C"<<std::endl;
+	for(size_t i=0;i<time_solve.size();++i)
+		results<<i+1<<","<<time_values[i]<<","<<deltat_values[i]<<","<<rejected_steps[i]<<","<<time_assemble[i]<<","<<time_prec[i]<<","<<time_solve[i]<<","<<time_output[i]<<","<<gmres_iterations[i]<<","<<inner_iterations[i]<<","<<preconditioner_rebuilt[i]<<","<<vec_drag[i]<<","<<vec_lift[i]<<","<<vec_drag_coeff[i]<<","<<vec_lift_coeff[i]<<std::endl;
+
+	results.close();
+
+}
+
+template class NavierStokes<2>;
+template class NavierStokes<3>;
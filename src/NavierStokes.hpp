@@ -0,0 +1,2509 @@
+#ifndef NAVIER_STOKES_HPP
+#define NAVIER_STOKES_HPP
+
+#include <deal.II/base/conditional_ostream.h>
+#include <deal.II/base/table.h>
+#include <deal.II/base/timer.h>
+#include <deal.II/base/vectorization.h>
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/parameter_handler.h>
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/work_stream.h>
+
+#include <deal.II/distributed/fully_distributed_tria.h>
+
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_renumbering.h>
+#include <deal.II/dofs/dof_tools.h>
+
+#include <deal.II/fe/fe_simplex_p.h>
+#include <deal.II/fe/fe_system.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/fe/fe_values_extractors.h>
+#include <deal.II/fe/mapping_fe.h>
+
+#include <deal.II/grid/filtered_iterator.h>
+#include <deal.II/grid/grid_in.h>
+
+#include <deal.II/lac/affine_constraints.h>
+#include <deal.II/lac/solver_cg.h>
+#include <deal.II/lac/solver_gmres.h>
+#include <deal.II/lac/trilinos_block_sparse_matrix.h>
+#include <deal.II/lac/trilinos_parallel_block_vector.h>
+#include <deal.II/lac/trilinos_precondition.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <deal.II/numerics/data_out.h>
+#include <deal.II/numerics/matrix_tools.h>
+#include <deal.II/numerics/vector_tools.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace dealii;
+
+// Number of DoFs per cell of the scalar simplex element of the given degree.
+constexpr unsigned int
+n_scalar_dofs_per_cell(const unsigned int dim, const unsigned int degree)
+{
+  unsigned int n_dofs = 1;
+  for (unsigned int d = 1; d <= dim; ++d)
+    n_dofs = n_dofs * (degree + d) / d;
+  return n_dofs;
+}
+
+// Number of DoFs per cell of the simplex element with dim velocity
+// components of degree degree_velocity and one pressure component of degree
+// degree_pressure.
+constexpr unsigned int
+n_dofs_per_cell(const unsigned int dim,
+                const unsigned int degree_velocity,
+                const unsigned int degree_pressure)
+{
+  return dim * n_scalar_dofs_per_cell(dim, degree_velocity) +
+         n_scalar_dofs_per_cell(dim, degree_pressure);
+}
+
+// Class implementing a solver for the Navier-Stokes problem, in two or three
+// dimensions (flow past a cylinder).
+template <int dim>
+class NavierStokes
+{
+public:
+
+  // Function for the forcing term.
+  class ForcingTerm : public Function<dim>
+  {
+  public:
+    ForcingTerm()
+    {
+    }
+
+    virtual void
+    vector_value(const Point<dim> & /*p*/,
+                 Vector<double> &values) const override
+    {
+      for (unsigned int i = 0; i < dim - 1; ++i)
+        values[i] = 0.0;
+
+      values[dim - 1] = -g;
+    }
+
+    virtual double
+    value(const Point<dim> & /*p*/,
+          const unsigned int component = 0) const override
+    {
+      if (component == dim - 1)
+        return -g;
+      else
+        return 0.0;
+    }
+
+    // The forcing term vanishes when g is zero, in which case its
+    // contribution to the right-hand side is skipped by the assembly.
+    bool
+    is_zero() const
+    {
+      return g == 0.0;
+    }
+
+  protected:
+    const double g = 0.0;
+  };
+
+  // Neumann boundary conditions.
+  class FunctionH : public Function<dim>
+  {
+  public:
+    // Constructor.
+    FunctionH()
+    {
+    }
+
+    // Evaluation.
+    virtual double
+    value(const Point<dim> & /*p*/, const unsigned int /*component*/ = 0) const override
+    {
+      return 0.;
+    }
+    virtual void
+    vector_value(const Point<dim> & /*p*/, Vector<double> &values) const override
+    {
+      for (unsigned int i = 0; i < dim; ++i)
+        values[i] = 0.;
+    }
+
+    // Homogeneous Neumann conditions: the boundary integral is skipped by the
+    // assembly.
+    bool
+    is_zero() const
+    {
+      return true;
+    }
+  };
+
+  // Function for the initial condition.
+  class FunctionU0 : public Function<dim>
+  {
+  public:
+    FunctionU0()
+    {
+    }
+
+    virtual double
+    value(const Point<dim> & /*p*/, const unsigned int component = 0) const
+    {
+      if (component == 0)
+        return 0.;
+      else
+        return 0.;
+    }
+    virtual void
+    vector_value(const Point<dim> & /*p*/, Vector<double> &values) const override
+    {
+      for (unsigned int i = 0; i < dim; ++i)
+        values[i] = 0.;
+    }
+  };
+
+  // Function for inlet velocity. This actually returns an object with dim + 1
+  // components (one for each velocity component, and one for the pressure),
+  // but then only the velocity components are really used (see the component
+  // mask when applying boundary conditions at the end of assembly). If we only
+  // return dim components, however, we may get an error message due to this
+  // function being incompatible with the finite element space.
+  //
+  // In 2D the inflow is uniform, in 3D it has the parabolic profile of the
+  // 3D-2Z benchmark.
+  class InletVelocity : public Function<dim>
+  {
+  public:
+    InletVelocity()
+        : Function<dim>(dim + 1)
+    {
+    }
+
+    virtual void
+    vector_value(const Point<dim> &p, Vector<double> &values) const override
+    {
+      values[0] = value(p, 0);
+      for (unsigned int i = 1; i < dim + 1; ++i)
+        values[i] = 0.0;
+    }
+
+    virtual double
+    value(const Point<dim> &p, const unsigned int component = 0) const override
+    {
+      if (component != 0)
+        return 0;
+
+      if constexpr (dim == 2)
+        return u_m;
+      else
+        return 16 * u_m * p[1] * p[2] * (H - p[1]) * (H - p[2]) /** std::sin(M_PI*get_time()/8.)*/ / (H * H * H * H);
+    }
+
+    // Whether value() depends on the time. If it does not, the Dirichlet
+    // values computed in setup() are reused at every time step.
+    bool
+    is_time_dependent() const
+    {
+      return false;
+    }
+
+    // Set the maximum inlet velocity.
+    void
+    set_maximum_velocity(const double &u_m_)
+    {
+      u_m = u_m_;
+    }
+
+    double getMeanVelocity() const
+    {
+      if constexpr (dim == 2)
+        return 2 * u_m / 3;
+      else
+        return u_m /** std::sin(M_PI*get_time()/8.)*/ *4/9;
+    }
+
+  protected:
+    double H = 0.41;
+    double u_m = dim == 2 ? 15 : 2.25;
+  };
+
+  // Since we're working with block matrices, we need to make our own
+  // preconditioner class. A preconditioner class can be any class that exposes
+  // a vmult method that applies the inverse of the preconditioner. The block
+  // preconditioners also declare, through needs_pressure_mass, whether they
+  // are built from the pressure mass matrix: the solver only allocates and
+  // assembles it if the one in use does.
+
+  // Identity preconditioner.
+  class PreconditionIdentity
+  {
+  public:
+    // Application of the preconditioner: we just copy the input vector (src)
+    // into the output vector (dst).
+    void
+    vmult(TrilinosWrappers::MPI::Vector &dst,
+          const TrilinosWrappers::MPI::Vector &src) const
+    {
+      dst = src;
+    }
+
+  protected:
+  };
+  class PreconditionBlockIdentity
+  {
+  public:
+    static constexpr bool needs_pressure_mass = false;
+
+    // Application of the preconditioner: we just copy the input vector (src)
+    // into the output vector (dst).
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      dst = src;
+    }
+
+  protected:
+  };
+
+  // Type of preconditioner used for the inner solves of the block
+  // preconditioners below.
+  enum class InnerPreconditionerType
+  {
+    ILU,
+    AMG
+  };
+
+  // Preconditioner for a single block: either an incomplete LU factorization
+  // or an algebraic multigrid V-cycle (Trilinos ML). The number of iterations
+  // of the inner solves stays close to mesh independent with the latter.
+  class InnerPreconditioner
+  {
+  public:
+    // Initialize the preconditioner of the given matrix. For AMG, elliptic
+    // tells whether the matrix is symmetric positive definite (otherwise a
+    // non-symmetric smoother and aggregation are used), and constant_modes
+    // is the near null space of the operator (one mode per velocity
+    // component for the velocity block, or empty for scalar problems).
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &matrix,
+               const InnerPreconditionerType &type_,
+               const bool &elliptic = true,
+               const std::vector<std::vector<bool>> &constant_modes = {})
+    {
+      type = type_;
+
+      if (type == InnerPreconditionerType::ILU)
+        preconditioner_ilu.initialize(matrix);
+      else
+      {
+        TrilinosWrappers::PreconditionAMG::AdditionalData amg_data;
+        amg_data.elliptic = elliptic;
+        amg_data.higher_order_elements = true;
+        amg_data.smoother_sweeps = 2;
+        amg_data.aggregation_threshold = 0.02;
+        amg_data.constant_modes = constant_modes;
+        preconditioner_amg.initialize(matrix, amg_data);
+      }
+    }
+
+    void
+    vmult(TrilinosWrappers::MPI::Vector &dst,
+          const TrilinosWrappers::MPI::Vector &src) const
+    {
+      if (type == InnerPreconditionerType::ILU)
+        preconditioner_ilu.vmult(dst, src);
+      else
+        preconditioner_amg.vmult(dst, src);
+    }
+
+  protected:
+    InnerPreconditionerType type = InnerPreconditionerType::ILU;
+
+    TrilinosWrappers::PreconditionILU preconditioner_ilu;
+    TrilinosWrappers::PreconditionAMG preconditioner_amg;
+  };
+
+  // How the inner solves of the block preconditioners are stopped.
+  enum class InnerSolveType
+  {
+    Tolerance,  // at a fixed relative tolerance
+    Adaptive,   // at a relative tolerance relaxed as the outer solver converges
+    Iterations, // after a fixed number of iterations, or at the tolerance
+    Application // no solve, a single application of the inner preconditioner
+  };
+
+  // Stopping criterion of the inner solves of a block preconditioner.
+  struct InnerSolve
+  {
+    InnerSolveType type = InnerSolveType::Tolerance;
+
+    // Relative tolerance, with respect to the norm of the right-hand side.
+    double tolerance = 1e-2;
+
+    // Number of iterations (Iterations only).
+    unsigned int n_iterations = 5;
+
+    // Approximately solve matrix x = b with a solver of type SolverType,
+    // stopping after max_iterations iterations at most (Tolerance and
+    // Adaptive only). Returns the number of iterations, one for a single
+    // application of the preconditioner.
+    template <typename SolverType, typename MatrixType, typename PreconditionType>
+    unsigned int
+    solve(const MatrixType &matrix,
+          TrilinosWrappers::MPI::Vector &x,
+          const TrilinosWrappers::MPI::Vector &b,
+          const PreconditionType &preconditioner,
+          const unsigned int &max_iterations) const
+    {
+      if (type == InnerSolveType::Application)
+      {
+        preconditioner.vmult(x, b);
+        return 1;
+      }
+
+      if (type == InnerSolveType::Iterations)
+      {
+        IterationNumberControl control(n_iterations, tolerance * b.l2_norm());
+        SolverType solver(control);
+        solver.solve(matrix, x, b, preconditioner);
+        return control.last_step();
+      }
+
+      SolverControl control(max_iterations, tolerance * b.l2_norm());
+      SolverType solver(control);
+      solver.solve(matrix, x, b, preconditioner);
+      return control.last_step();
+    }
+  };
+
+  // Block-diagonal preconditioner.
+  class PreconditionBlockDiagonal
+  {
+  public:
+    static constexpr bool needs_pressure_mass = true;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    // Initialize the preconditioner, given the velocity stiffness matrix, the
+    // pressure mass matrix.
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &velocity_stiffness_,
+               const TrilinosWrappers::SparseMatrix &pressure_mass_,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      velocity_stiffness = &velocity_stiffness_;
+      pressure_mass = &pressure_mass_;
+
+      preconditioner_velocity.initialize(velocity_stiffness_,
+                                         inner_type,
+                                         true,
+                                         velocity_constant_modes);
+      preconditioner_pressure.initialize(pressure_mass_, inner_type);
+    }
+
+    // Application of the preconditioner.
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *velocity_stiffness,
+              dst.block(0),
+              src.block(0),
+              preconditioner_velocity,
+              1000);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *pressure_mass,
+              dst.block(1),
+              src.block(1),
+              preconditioner_pressure,
+              1000);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    // Velocity stiffness matrix.
+    const TrilinosWrappers::SparseMatrix *velocity_stiffness;
+
+    // Preconditioner used for the velocity block.
+    InnerPreconditioner preconditioner_velocity;
+
+    // Pressure mass matrix.
+    const TrilinosWrappers::SparseMatrix *pressure_mass;
+
+    // Preconditioner used for the pressure block.
+    InnerPreconditioner preconditioner_pressure;
+  };
+
+  // Block-triangular preconditioner.
+  class PreconditionBlockTriangular
+  {
+  public:
+    static constexpr bool needs_pressure_mass = true;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    // Initialize the preconditioner, given the velocity stiffness matrix, the
+    // pressure mass matrix.
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &velocity_stiffness_,
+               const TrilinosWrappers::SparseMatrix &pressure_mass_,
+               const TrilinosWrappers::SparseMatrix &B_,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      velocity_stiffness = &velocity_stiffness_;
+      pressure_mass = &pressure_mass_;
+      B = &B_;
+
+      preconditioner_velocity.initialize(velocity_stiffness_,
+                                         inner_type,
+                                         true,
+                                         velocity_constant_modes);
+      preconditioner_pressure.initialize(pressure_mass_, inner_type);
+    }
+
+    // Application of the preconditioner.
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *velocity_stiffness,
+              dst.block(0),
+              src.block(0),
+              preconditioner_velocity,
+              1000);
+
+      tmp.reinit(src.block(1));
+      B->vmult(tmp, dst.block(0));
+      tmp.sadd(-1.0, src.block(1));
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *pressure_mass,
+              dst.block(1),
+              tmp,
+              preconditioner_pressure,
+              1000);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    // Velocity stiffness matrix.
+    const TrilinosWrappers::SparseMatrix *velocity_stiffness;
+
+    // Preconditioner used for the velocity block.
+    InnerPreconditioner preconditioner_velocity;
+
+    // Pressure mass matrix.
+    const TrilinosWrappers::SparseMatrix *pressure_mass;
+
+    // Preconditioner used for the pressure block.
+    InnerPreconditioner preconditioner_pressure;
+
+    // B matrix.
+    const TrilinosWrappers::SparseMatrix *B;
+
+    // Temporary vector.
+    mutable TrilinosWrappers::MPI::Vector tmp;
+  };
+
+  class PreconditionSIMPLE
+  {
+  public:
+    static constexpr bool needs_pressure_mass = false;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &F_,
+               const TrilinosWrappers::SparseMatrix &B_,
+               const TrilinosWrappers::SparseMatrix &B_t,
+               const TrilinosWrappers::MPI::BlockVector &sol_owned,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      F = &F_;
+      B = &B_;
+      B_T = &B_t;
+
+      diag_D_inv.reinit(sol_owned.block(0));
+
+      for (unsigned int i : diag_D_inv.locally_owned_elements())
+      {
+        double temp = F->diag_element(i);
+        diag_D_inv[i] = 1.0 / temp;
+      }
+
+      // Create S_tilde
+      B_.mmult(S_tilde, B_t, diag_D_inv);
+
+      // Initialize the preconditioners
+      preconditioner_F.initialize(*F, inner_type, false, velocity_constant_modes);
+      preconditioner_S.initialize(S_tilde, inner_type);
+    }
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      const unsigned int maxiter = 10000;
+
+      // Store in temporaries the results
+      TrilinosWrappers::MPI::Vector y_u = src.block(0);
+      TrilinosWrappers::MPI::Vector y_p = src.block(1);
+
+      TrilinosWrappers::MPI::Vector temp_1 = src.block(1);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverGMRES<TrilinosWrappers::MPI::Vector>>(
+              *F, y_u, src.block(0), preconditioner_F, maxiter);
+
+      B->vmult(temp_1, y_u);
+      temp_1 -= src.block(1);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              S_tilde, y_p, temp_1, preconditioner_S, maxiter);
+
+      dst.block(1) = y_p;
+      dst.block(1) *= 1. / alpha;
+      //temp_1.reinit(dst.block(0));
+
+      B_T->vmult(dst.block(0), dst.block(1));
+      // Cannot be same vector
+      //D_inv.vmult(dst.block(0), temp_1);
+      dst.block(0).scale(diag_D_inv);
+      dst.block(0) -= y_u;
+      dst.block(0) *= -1.;
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    const double alpha = 0.5;
+
+    const TrilinosWrappers::SparseMatrix *F;
+    const TrilinosWrappers::SparseMatrix *B_T;
+    const TrilinosWrappers::SparseMatrix *B;
+    TrilinosWrappers::SparseMatrix S_tilde;
+    TrilinosWrappers::MPI::Vector diag_D_inv;
+    InnerPreconditioner preconditioner_F;
+    InnerPreconditioner preconditioner_S;
+  };
+
+  class PreconditionaSIMPLE
+  {
+  public:
+    static constexpr bool needs_pressure_mass = false;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &F_,
+               const TrilinosWrappers::SparseMatrix &B_,
+               const TrilinosWrappers::SparseMatrix &B_t,
+               const TrilinosWrappers::MPI::BlockVector &sol_owned,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      F = &F_;
+      B = &B_;
+      B_T = &B_t;
+
+      diag_D_inv.reinit(sol_owned.block(0));
+      diag_D.reinit(sol_owned.block(0));
+
+      for (unsigned int i : diag_D.locally_owned_elements())
+      {
+        double temp = F->diag_element(i);
+        diag_D[i] = -temp;
+        diag_D_inv[i] = 1.0 / temp;
+      }
+
+      B->mmult(S, *B_T, diag_D_inv);
+
+      preconditionerF.initialize(*F, inner_type, false, velocity_constant_modes);
+      preconditionerS.initialize(S, inner_type);
+    }
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      const unsigned int maxiter = 10000;
+
+      tmp.reinit(src.block(1));
+      // preconditionerF.vmult(dst.block(0), src.block(0));
+      inner_iterations +=
+          inner_solve.template solve<SolverGMRES<TrilinosWrappers::MPI::Vector>>(
+              *F, dst.block(0), src.block(0), preconditionerF, maxiter);
+
+      dst.block(1) = src.block(1);
+      B->vmult(dst.block(1), dst.block(0));
+      dst.block(1).sadd(-1.0, src.block(1));
+      tmp = dst.block(1);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              S, dst.block(1), tmp, preconditionerS, maxiter);
+      // preconditionerS.vmult(dst.block(1), tmp);
+
+      dst.block(0).scale(diag_D);
+      dst.block(1) *= 1.0 / alpha;
+      B_T->vmult_add(dst.block(0), dst.block(1));
+      dst.block(0).scale(diag_D_inv);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    const TrilinosWrappers::SparseMatrix *F;
+    const TrilinosWrappers::SparseMatrix *B_T;
+    const TrilinosWrappers::SparseMatrix *B;
+    TrilinosWrappers::SparseMatrix S;
+
+    InnerPreconditioner preconditionerF;
+    InnerPreconditioner preconditionerS;
+
+    TrilinosWrappers::MPI::Vector diag_D;
+    TrilinosWrappers::MPI::Vector diag_D_inv;
+    mutable TrilinosWrappers::MPI::Vector tmp;
+    mutable TrilinosWrappers::MPI::Vector tmp2;
+    const double alpha = 0.5;
+  };
+
+  // Block-triangular preconditioner with the pressure convection-diffusion
+  // (PCD) approximation of the Schur complement S = B F^{-1} B^T,
+  //   S^{-1} ~ M_p^{-1} F_p A_p^{-1},
+  // where M_p is the pressure mass matrix, A_p the pressure Laplacian and F_p
+  // the convection-diffusion operator of F (time derivative, viscosity and
+  // convection by the current velocity) discretized on the pressure space.
+  // Unlike B diag(F)^{-1} B^T, it accounts for convection, so that the outer
+  // iterations stay roughly constant with the Reynolds number and the mesh
+  // size. A_p and F_p are built with homogeneous Dirichlet conditions on the
+  // outlet, where the pressure is set by the natural boundary condition.
+  class PreconditionPCD
+  {
+  public:
+    static constexpr bool needs_pressure_mass = true;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    // Initialize the preconditioner, given the velocity block F, the block
+    // B^T, the pressure mass matrix (divided by the viscosity nu_, as
+    // assembled by assemble_constant()), the pressure Laplacian and
+    // convection-diffusion matrices, and a vector that is zero on the
+    // pressure DoFs constrained on the outlet and one elsewhere.
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &F_,
+               const TrilinosWrappers::SparseMatrix &B_t,
+               const TrilinosWrappers::SparseMatrix &pressure_mass_,
+               const TrilinosWrappers::SparseMatrix &pressure_laplacian_,
+               const TrilinosWrappers::SparseMatrix &pressure_convection_diffusion_,
+               const TrilinosWrappers::MPI::Vector &free_pressure_,
+               const double &nu_,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      F = &F_;
+      B_T = &B_t;
+      pressure_mass = &pressure_mass_;
+      pressure_laplacian = &pressure_laplacian_;
+      pressure_convection_diffusion = &pressure_convection_diffusion_;
+      free_pressure = &free_pressure_;
+      nu = nu_;
+
+      preconditioner_F.initialize(*F, inner_type, false, velocity_constant_modes);
+      preconditioner_mass.initialize(*pressure_mass, inner_type);
+      preconditioner_laplacian.initialize(*pressure_laplacian, inner_type);
+    }
+
+    // Application of the preconditioner: first the pressure, with the PCD
+    // approximation of -S^{-1}, then the velocity, solving F with the
+    // pressure coupling moved to the right-hand side.
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      const unsigned int maxiter = 10000;
+
+      tmp_p = src.block(1);
+      tmp_p.scale(*free_pressure);
+      y_p.reinit(tmp_p);
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *pressure_laplacian, y_p, tmp_p, preconditioner_laplacian, maxiter);
+
+      pressure_convection_diffusion->vmult(tmp_p, y_p);
+      tmp_p.scale(*free_pressure);
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              *pressure_mass, dst.block(1), tmp_p, preconditioner_mass, maxiter);
+
+      // The pressure mass matrix is divided by nu.
+      dst.block(1) *= -1.0 / nu;
+
+      tmp_u.reinit(src.block(0));
+      B_T->vmult(tmp_u, dst.block(1));
+      tmp_u.sadd(-1.0, src.block(0));
+      inner_iterations +=
+          inner_solve.template solve<SolverGMRES<TrilinosWrappers::MPI::Vector>>(
+              *F, dst.block(0), tmp_u, preconditioner_F, maxiter);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    const TrilinosWrappers::SparseMatrix *F;
+    const TrilinosWrappers::SparseMatrix *B_T;
+    const TrilinosWrappers::SparseMatrix *pressure_mass;
+    const TrilinosWrappers::SparseMatrix *pressure_laplacian;
+    const TrilinosWrappers::SparseMatrix *pressure_convection_diffusion;
+
+    // Zero on the pressure DoFs constrained on the outlet, one elsewhere.
+    const TrilinosWrappers::MPI::Vector *free_pressure;
+
+    double nu;
+
+    InnerPreconditioner preconditioner_F;
+    InnerPreconditioner preconditioner_mass;
+    InnerPreconditioner preconditioner_laplacian;
+
+    mutable TrilinosWrappers::MPI::Vector tmp_u;
+    mutable TrilinosWrappers::MPI::Vector tmp_p;
+    mutable TrilinosWrappers::MPI::Vector y_p;
+  };
+
+  // Block-triangular preconditioner with the least-squares commutator (LSC)
+  // approximation of the Schur complement S = B F^{-1} B^T,
+  //   S^{-1} ~ (B Q^{-1} B^T)^{-1} (B Q^{-1} F Q^{-1} B^T) (B Q^{-1} B^T)^{-1},
+  // where Q is the lumped velocity mass matrix. It is built only from the
+  // blocks of the system matrix, without operators on the pressure space or
+  // boundary conditions of its own.
+  class PreconditionLSC
+  {
+  public:
+    static constexpr bool needs_pressure_mass = false;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    // Initialize the preconditioner, given the blocks F, B and B^T of the
+    // system matrix and the diagonal of the lumped velocity mass matrix.
+    void
+    initialize(const TrilinosWrappers::SparseMatrix &F_,
+               const TrilinosWrappers::SparseMatrix &B_,
+               const TrilinosWrappers::SparseMatrix &B_t,
+               const TrilinosWrappers::MPI::Vector &lumped_mass,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU,
+               const std::vector<std::vector<bool>> &velocity_constant_modes = {})
+    {
+      F = &F_;
+      B = &B_;
+      B_T = &B_t;
+
+      lumped_mass_inv.reinit(lumped_mass);
+      for (unsigned int i : lumped_mass_inv.locally_owned_elements())
+        lumped_mass_inv[i] = 1.0 / lumped_mass[i];
+
+      // B Q^{-1} B^T, symmetric positive definite.
+      B->mmult(S_Q, *B_T, lumped_mass_inv);
+
+      preconditioner_F.initialize(*F, inner_type, false, velocity_constant_modes);
+      preconditioner_S_Q.initialize(S_Q, inner_type);
+    }
+
+    // Application of the preconditioner: first the pressure, with the LSC
+    // approximation of -S^{-1}, then the velocity, solving F with the
+    // pressure coupling moved to the right-hand side.
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      const unsigned int maxiter = 10000;
+
+      y_p.reinit(src.block(1));
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              S_Q, y_p, src.block(1), preconditioner_S_Q, maxiter);
+
+      tmp_u.reinit(src.block(0));
+      tmp_u2.reinit(src.block(0));
+      B_T->vmult(tmp_u, y_p);
+      tmp_u.scale(lumped_mass_inv);
+      F->vmult(tmp_u2, tmp_u);
+      tmp_u2.scale(lumped_mass_inv);
+      B->vmult(y_p, tmp_u2);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              S_Q, dst.block(1), y_p, preconditioner_S_Q, maxiter);
+      dst.block(1) *= -1.0;
+
+      B_T->vmult(tmp_u, dst.block(1));
+      tmp_u.sadd(-1.0, src.block(0));
+      inner_iterations +=
+          inner_solve.template solve<SolverGMRES<TrilinosWrappers::MPI::Vector>>(
+              *F, dst.block(0), tmp_u, preconditioner_F, maxiter);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    const TrilinosWrappers::SparseMatrix *F;
+    const TrilinosWrappers::SparseMatrix *B_T;
+    const TrilinosWrappers::SparseMatrix *B;
+
+    // Inverse of the lumped velocity mass matrix, and B Q^{-1} B^T.
+    TrilinosWrappers::MPI::Vector lumped_mass_inv;
+    TrilinosWrappers::SparseMatrix S_Q;
+
+    InnerPreconditioner preconditioner_F;
+    InnerPreconditioner preconditioner_S_Q;
+
+    mutable TrilinosWrappers::MPI::Vector tmp_u;
+    mutable TrilinosWrappers::MPI::Vector tmp_u2;
+    mutable TrilinosWrappers::MPI::Vector y_p;
+  };
+
+  // Matrix-free evaluation of the linearized (Oseen) operator. The
+  // velocity-velocity block is never stored: it is applied on the fly, cell by
+  // cell, using the convective velocity cached at the quadrature points of the
+  // locally owned cells. The pressure coupling blocks B and B^T are much
+  // smaller and are still taken from the assembled system matrix.
+  class OseenOperator
+  {
+  public:
+    // Initialize the operator, given the DoF handler, the quadrature formula,
+    // the system matrix holding the pressure coupling blocks and the index sets
+    // of the velocity block.
+    void
+    initialize(const DoFHandler<dim> &dof_handler_,
+               const Quadrature<dim> &quadrature_,
+               const TrilinosWrappers::BlockSparseMatrix &system_matrix_,
+               const IndexSet &velocity_owned_dofs,
+               const IndexSet &velocity_relevant_dofs,
+               const double &nu_);
+
+    // Update the convective velocity (taken from a vector with ghost
+    // elements), the time step and the rows constrained by Dirichlet
+    // conditions. This also recomputes the diagonal of the velocity block.
+    void
+    reinit(const TrilinosWrappers::MPI::BlockVector &convective_velocity,
+           const double &deltat_,
+           const std::map<types::global_dof_index, double> &boundary_values);
+
+    // Application of the whole block operator.
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const;
+
+    // Application of the velocity-velocity block only.
+    void
+    vmult(TrilinosWrappers::MPI::Vector &dst,
+          const TrilinosWrappers::MPI::Vector &src) const;
+
+    // Diagonal of the velocity-velocity block.
+    const TrilinosWrappers::MPI::Vector &
+    get_diagonal() const
+    {
+      return diagonal;
+    }
+
+  protected:
+    // Loop over the locally owned cells, applying the velocity-velocity block
+    // to src (if diagonal_only is false) or accumulating its diagonal into dst
+    // (if diagonal_only is true).
+    void
+    cell_loop(TrilinosWrappers::MPI::Vector &dst,
+              const TrilinosWrappers::MPI::Vector &src,
+              const bool diagonal_only) const;
+
+    const DoFHandler<dim> *dof_handler;
+    const Quadrature<dim> *quadrature;
+    const TrilinosWrappers::BlockSparseMatrix *system_matrix;
+
+    double nu;
+    double deltat;
+
+    // FEValues object reused by every application of the operator.
+    std::unique_ptr<FEValues<dim>> fe_values;
+
+    // Local indices of the velocity shape functions of a cell.
+    std::vector<unsigned int> velocity_local_dofs;
+
+    // Convective velocity at the quadrature points of the locally owned cells.
+    std::vector<Tensor<1, dim>> convective_velocity_values;
+
+    // Locally owned velocity DoFs subject to Dirichlet conditions: the
+    // corresponding rows of the operator are replaced by the identity.
+    std::vector<types::global_dof_index> constrained_dofs;
+
+    // Diagonal of the velocity-velocity block.
+    TrilinosWrappers::MPI::Vector diagonal;
+
+    // Velocity source vector including ghost elements.
+    mutable TrilinosWrappers::MPI::Vector src_ghosted;
+  };
+
+  // Solutions of the last time steps, used to compute the initial guess of
+  // the outer solver.
+  class SolutionHistory
+  {
+  public:
+    // Set the number of solutions kept (0 disables the history).
+    void
+    set_size(const unsigned int &max_size_)
+    {
+      max_size = max_size_;
+      while (solutions.size() > max_size)
+        solutions.pop_back();
+    }
+
+    // Store the solution at the given time, dropping the oldest one if the
+    // history is full.
+    void
+    add(const double &time, const TrilinosWrappers::MPI::BlockVector &solution)
+    {
+      if (max_size == 0)
+        return;
+      if (solutions.size() == max_size)
+        solutions.pop_back();
+      solutions.emplace_front(time, solution);
+    }
+
+    // Extrapolate the last degree + 1 solutions (or as many as available) in
+    // time, with the Lagrange polynomial through them, deltat after the last
+    // one. Returns false, leaving dst untouched, if less than two solutions
+    // are available.
+    bool
+    extrapolate(const double &deltat,
+                const unsigned int &degree,
+                TrilinosWrappers::MPI::BlockVector &dst) const
+    {
+      const unsigned int n = std::min<std::size_t>(degree + 1, solutions.size());
+      if (n < 2)
+        return false;
+
+      const double time = solutions.front().first + deltat;
+      dst = 0.0;
+      for (unsigned int i = 0; i < n; ++i)
+      {
+        double weight = 1.0;
+        for (unsigned int j = 0; j < n; ++j)
+          if (j != i)
+            weight *= (time - solutions[j].first) /
+                      (solutions[i].first - solutions[j].first);
+        dst.add(weight, solutions[i].second);
+      }
+      return true;
+    }
+
+    // Combination of the stored solutions minimizing the residual of the
+    // system A x = rhs, found by a QR factorization (modified Gram-Schmidt)
+    // of the images of the solutions through A. Solutions whose image is
+    // (nearly) linearly dependent on the previous ones are skipped. Returns
+    // false, leaving dst untouched, if no solution is available.
+    template <typename OperatorType>
+    bool
+    project(const OperatorType &A,
+            const TrilinosWrappers::MPI::BlockVector &rhs,
+            TrilinosWrappers::MPI::BlockVector &dst) const
+    {
+      if (solutions.empty())
+        return false;
+
+      // Orthonormal basis Q of the span of the images, the columns of R, and
+      // the indices of the solutions they correspond to.
+      std::vector<TrilinosWrappers::MPI::BlockVector> Q;
+      std::vector<std::vector<double>> R;
+      std::vector<unsigned int> used;
+
+      TrilinosWrappers::MPI::BlockVector w(rhs);
+      for (unsigned int j = 0; j < solutions.size(); ++j)
+      {
+        A.vmult(w, solutions[j].second);
+        const double norm = w.l2_norm();
+
+        std::vector<double> r(Q.size() + 1);
+        for (unsigned int i = 0; i < Q.size(); ++i)
+        {
+          r[i] = Q[i] * w;
+          w.add(-r[i], Q[i]);
+        }
+        r.back() = w.l2_norm();
+
+        if (r.back() <= 1e-10 * norm)
+          continue;
+
+        w /= r.back();
+        Q.push_back(w);
+        R.push_back(r);
+        used.push_back(j);
+      }
+
+      if (Q.empty())
+        return false;
+
+      // Solve R c = Q^T rhs by back substitution.
+      std::vector<double> c(Q.size());
+      for (unsigned int i = Q.size(); i-- > 0;)
+      {
+        c[i] = Q[i] * rhs;
+        for (unsigned int k = i + 1; k < Q.size(); ++k)
+          c[i] -= R[k][i] * c[k];
+        c[i] /= R[i][i];
+      }
+
+      dst = 0.0;
+      for (unsigned int i = 0; i < Q.size(); ++i)
+        dst.add(c[i], solutions[used[i]].second);
+      return true;
+    }
+
+  protected:
+    // Number of solutions kept.
+    unsigned int max_size = 0;
+
+    // Times and solutions, the most recent first.
+    std::deque<std::pair<double, TrilinosWrappers::MPI::BlockVector>> solutions;
+  };
+
+  // Diagonal (Jacobi) preconditioner, given the inverse of the diagonal.
+  class PreconditionDiagonal
+  {
+  public:
+    void
+    initialize(const TrilinosWrappers::MPI::Vector &diagonal_inverse_)
+    {
+      diagonal_inverse = &diagonal_inverse_;
+    }
+
+    void
+    vmult(TrilinosWrappers::MPI::Vector &dst,
+          const TrilinosWrappers::MPI::Vector &src) const
+    {
+      dst = src;
+      dst.scale(*diagonal_inverse);
+    }
+
+  protected:
+    const TrilinosWrappers::MPI::Vector *diagonal_inverse;
+  };
+
+  // aSIMPLE preconditioner for the matrix-free operator. Since the velocity
+  // block is not stored, F is inverted by Jacobi-preconditioned GMRES, while
+  // the approximate Schur complement B diag(F)^{-1} B^T is still built
+  // explicitly from the diagonal computed by the operator.
+  class PreconditionaSIMPLEMatrixFree
+  {
+  public:
+    static constexpr bool needs_pressure_mass = false;
+
+    // Set how the inner solves are stopped.
+    void
+    set_inner_solve(const InnerSolve &inner_solve_)
+    {
+      inner_solve = inner_solve_;
+    }
+
+    // Total number of iterations of the inner solves of all applications.
+    unsigned long long
+    get_inner_iterations() const
+    {
+      return inner_iterations;
+    }
+
+    void
+    initialize(const OseenOperator &F_,
+               const TrilinosWrappers::SparseMatrix &B_,
+               const TrilinosWrappers::SparseMatrix &B_t,
+               const InnerPreconditionerType &inner_type = InnerPreconditionerType::ILU)
+    {
+      F = &F_;
+      B = &B_;
+      B_T = &B_t;
+
+      diag_D_inv.reinit(F->get_diagonal());
+      diag_D.reinit(F->get_diagonal());
+
+      for (unsigned int i : diag_D.locally_owned_elements())
+      {
+        double temp = F->get_diagonal()[i];
+        diag_D[i] = -temp;
+        diag_D_inv[i] = 1.0 / temp;
+      }
+
+      B->mmult(S, *B_T, diag_D_inv);
+
+      preconditionerF.initialize(diag_D_inv);
+      preconditionerS.initialize(S, inner_type);
+    }
+    void
+    vmult(TrilinosWrappers::MPI::BlockVector &dst,
+          const TrilinosWrappers::MPI::BlockVector &src) const
+    {
+      const unsigned int maxiter = 10000;
+
+      tmp.reinit(src.block(1));
+      inner_iterations +=
+          inner_solve.template solve<SolverGMRES<TrilinosWrappers::MPI::Vector>>(
+              *F, dst.block(0), src.block(0), preconditionerF, maxiter);
+
+      B->vmult(dst.block(1), dst.block(0));
+      dst.block(1).sadd(-1.0, src.block(1));
+      tmp = dst.block(1);
+
+      inner_iterations +=
+          inner_solve.template solve<SolverCG<TrilinosWrappers::MPI::Vector>>(
+              S, dst.block(1), tmp, preconditionerS, maxiter);
+
+      dst.block(0).scale(diag_D);
+      dst.block(1) *= 1.0 / alpha;
+      B_T->vmult_add(dst.block(0), dst.block(1));
+      dst.block(0).scale(diag_D_inv);
+    }
+
+  protected:
+    // Stopping criterion of the inner solves.
+    InnerSolve inner_solve;
+
+    // Iterations of the inner solves, updated by vmult().
+    mutable unsigned long long inner_iterations = 0;
+
+    const OseenOperator *F;
+    const TrilinosWrappers::SparseMatrix *B_T;
+    const TrilinosWrappers::SparseMatrix *B;
+    TrilinosWrappers::SparseMatrix S;
+
+    PreconditionDiagonal preconditionerF;
+    InnerPreconditioner preconditionerS;
+
+    TrilinosWrappers::MPI::Vector diag_D;
+    TrilinosWrappers::MPI::Vector diag_D_inv;
+    mutable TrilinosWrappers::MPI::Vector tmp;
+    const double alpha = 0.5;
+  };
+
+  // Hierarchical wall-clock profiler. Timed sections can be nested: each
+  // section is identified by its path (e.g. "time loop/solve"), and records
+  // the number of calls and the wall time spent in it on this process.
+  // Counters accumulate other quantities (iterations, bytes written). The
+  // summary reduces both across the processes.
+  class Profiler
+  {
+  public:
+    // Time the enclosing C++ scope as a section, nested in the current one.
+    class Scope
+    {
+    public:
+      Scope(Profiler &profiler_, const std::string &name)
+          : profiler(profiler_)
+      {
+        profiler.enter(name);
+      }
+
+      ~Scope()
+      {
+        profiler.leave();
+      }
+
+    protected:
+      Profiler &profiler;
+    };
+
+    // Start a section, nested in the current one.
+    void
+    enter(const std::string &name);
+
+    // End the current section.
+    void
+    leave();
+
+    // Add value to the counter with the given name.
+    void
+    add(const std::string &name, const double &value)
+    {
+      counters[name] += value;
+    }
+
+    // Print the minimum, maximum and average over the processes of the time
+    // spent in each section and of each counter, and write them to
+    // prefix.json and prefix.csv.
+    void
+    write_summary(const std::string &prefix, ConditionalOStream &pcout) const;
+
+  protected:
+    struct Section
+    {
+      unsigned long long calls = 0;
+      double wall_time = 0.0;
+    };
+
+    // Path and start time of the open sections, innermost last.
+    std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>>
+        open_sections;
+
+    std::map<std::string, Section> sections;
+    std::map<std::string, double> counters;
+  };
+
+  // Block preconditioner of the outer GMRES solver (in matrix-free mode the
+  // matrix-free aSIMPLE preconditioner is always used).
+  enum class PreconditionerType
+  {
+    BlockDiagonal,
+    BlockTriangular,
+    SIMPLE,
+    aSIMPLE,
+    PCD,
+    LSC
+  };
+
+  // Constructor.
+  NavierStokes(const std::string &mesh_file_name_,
+               const unsigned int &degree_velocity_,
+               const unsigned int &degree_pressure_,
+               const double &T_,
+               const double &deltat_,
+               const bool &matrix_free_ = false)
+      : mpi_size(Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD)), mpi_rank(Utilities::MPI::this_mpi_process(MPI_COMM_WORLD)), pcout(std::cout, mpi_rank == 0), mesh_file_name(mesh_file_name_), degree_velocity(degree_velocity_), degree_pressure(degree_pressure_), T(T_), deltat(deltat_), matrix_free(matrix_free_), mesh(MPI_COMM_WORLD)
+  {
+  }
+
+  // Constructor from the parameters declared by declare_parameters(), which
+  // also applies all the settings below.
+  NavierStokes(ParameterHandler &prm);
+
+  // Declare the parameters of the solver, with the defaults of the 2D or 3D
+  // benchmark.
+  static void
+  declare_parameters(ParameterHandler &prm);
+
+  // Read the parameters from the command line: an optional parameter file,
+  // followed by any number of overrides of the form "Section/Name=value"
+  // (e.g. "Linear solver/Preconditioner=SIMPLE").
+  static void
+  parse_command_line(ParameterHandler &prm, const int argc, char *argv[]);
+
+  // Setup system.
+  void
+  setup();
+
+  // Solve system.
+  void
+  solve();
+
+  // Write the per-step history below to results_<dim>D.csv.
+  void
+  output_results() const;
+
+  // Select the block preconditioner of the outer solver.
+  void
+  set_preconditioner(const PreconditionerType &type)
+  {
+    preconditioner_type = type;
+  }
+
+  // Krylov solver of the outer iterations. The block preconditioners solve
+  // their inner systems only approximately, so that they change from one
+  // outer iteration to the next: flexible GMRES (FGMRES) allows for that, at
+  // the price of storing twice as many basis vectors as GMRES.
+  enum class OuterSolverType
+  {
+    GMRES,
+    FGMRES
+  };
+
+  // Select the outer solver (the default is FGMRES).
+  void
+  set_outer_solver(const OuterSolverType &type)
+  {
+    outer_solver_type = type;
+  }
+
+  // Select how the inner solves of the block preconditioners are stopped
+  // (the default is Tolerance, at the inner tolerance of set_linear_solver()).
+  // With Iterations, they stop after n_iterations iterations. With Adaptive,
+  // the inner tolerance is relaxed as the outer residual r_k decreases, to
+  // inner_tolerance * |r_0| / |r_k|, up to max_tolerance: the later outer
+  // iterations contribute less to the solution, and can be preconditioned less
+  // accurately (this requires the flexible outer solver).
+  void
+  set_inner_solve(const InnerSolveType &type,
+                  const unsigned int &n_iterations = 5,
+                  const double &max_tolerance = 0.1)
+  {
+    inner_solve_type = type;
+    inner_solve_iterations = n_iterations;
+    inner_tolerance_max = max_tolerance;
+  }
+
+  // Initial guess of the outer solver at each time step.
+  enum class InitialGuessType
+  {
+    Previous,   // the solution of the previous time step
+    Linear,     // linear extrapolation from the last two time steps
+    Quadratic,  // quadratic extrapolation from the last three time steps
+    Projection  // minimal residual combination of the last time steps
+  };
+
+  // Select the initial guess (the default is Previous). n_projection_vectors
+  // is the number of solutions kept by the Projection guess.
+  void
+  set_initial_guess(const InitialGuessType &type,
+                    const unsigned int &n_projection_vectors = 5)
+  {
+    initial_guess_type = type;
+    switch (type)
+    {
+    case InitialGuessType::Previous:
+      solution_history.set_size(0);
+      break;
+    case InitialGuessType::Linear:
+      solution_history.set_size(2);
+      break;
+    case InitialGuessType::Quadratic:
+      solution_history.set_size(3);
+      break;
+    case InitialGuessType::Projection:
+      solution_history.set_size(n_projection_vectors);
+      break;
+    }
+  }
+
+  // Set the tolerance of the outer solver (relative to the norm of the
+  // right-hand side), its restart length, and the relative tolerance of the
+  // inner solves of the block preconditioners.
+  void
+  set_linear_solver(const double &tolerance,
+                    const unsigned int &restart_length,
+                    const double &inner_tolerance_)
+  {
+    solver_tolerance = tolerance;
+    gmres_restart_length = restart_length;
+    inner_tolerance = inner_tolerance_;
+  }
+
+  // Set the viscosity and the maximum inlet velocity.
+  void
+  set_physical_parameters(const double &nu_, const double &u_m)
+  {
+    nu = nu_;
+    inlet_velocity.set_maximum_velocity(u_m);
+  }
+
+  // Select the preconditioner used for the velocity block and for the
+  // approximate Schur complement inside the block preconditioners.
+  void
+  set_inner_preconditioner(const InnerPreconditionerType &type)
+  {
+    inner_preconditioner_type = type;
+  }
+
+  // Set how the mesh is read in setup(): only the first process of each group
+  // of group_size processes reads and partitions the whole mesh (0 means a
+  // single group, so that only rank 0 reads it). If partition_file_prefix_ is
+  // not empty, the partitioned mesh is saved to files with that prefix, and
+  // read back from them by later runs with the same number of processes.
+  void
+  set_mesh_partitioning(const unsigned int &group_size,
+                        const std::string &partition_file_prefix_)
+  {
+    mesh_group_size = group_size;
+    partition_file_prefix = partition_file_prefix_;
+  }
+
+  // Format of the output files: one VTU file per process and time step (plus
+  // a PVTU record), or one HDF5 file per time step indexed by a single XDMF
+  // file.
+  enum class OutputFormat
+  {
+    VTU,
+    HDF5
+  };
+
+  // Select the format of the output files.
+  void
+  set_output_format(const OutputFormat &format)
+  {
+    output_format = format;
+  }
+
+  // Write a checkpoint every wall_time_interval seconds of wall time (0
+  // disables checkpoints), to files starting with prefix. If restart_ is
+  // true, solve() continues from the checkpoint with the same prefix, if it
+  // exists. The checkpoint can be read on any number of processes.
+  void
+  set_checkpointing(const double &wall_time_interval,
+                    const std::string &prefix,
+                    const bool &restart_)
+  {
+    checkpoint_interval = wall_time_interval;
+    checkpoint_prefix = prefix;
+    restart = restart_;
+  }
+
+  // Set how often the solution is written: every every_n_steps time steps
+  // or, if every_dt is positive, every every_dt units of simulated time.
+  void
+  set_output_frequency(const unsigned int &every_n_steps,
+                       const double &every_dt = 0.0)
+  {
+    output_interval = every_n_steps;
+    output_time_interval = every_dt;
+    next_output_time = every_dt;
+  }
+
+  // Enable adaptive time stepping: after each step, the time step is
+  // adapted so that the CFL number is close to target_cfl, within
+  // [deltat_min_, deltat_max_]. A step whose CFL number exceeds the target by
+  // more than 50%, or whose linear solve does not converge, is rejected and
+  // repeated with a smaller time step.
+  void
+  set_adaptive_time_step(const double &target_cfl,
+                         const double &deltat_min_,
+                         const double &deltat_max_)
+  {
+    adaptive_time_step = true;
+    cfl_target = target_cfl;
+    deltat_min = deltat_min_;
+    deltat_max = deltat_max_;
+  }
+
+  // Set the refresh policy of the preconditioner: it is rebuilt when the
+  // previous time step took more than max_iterations GMRES iterations, or
+  // when it has been used for max_age time steps. The default (max_age = 1)
+  // rebuilds it at every time step.
+  void
+  set_preconditioner_refresh(const unsigned int &max_iterations,
+                             const unsigned int &max_age)
+  {
+    preconditioner_max_iterations = max_iterations;
+    preconditioner_max_age = max_age;
+  }
+
+  // Engine used to assemble the convective term and the right-hand side at
+  // each time step: one cell at a time, or batches of cells processed
+  // together with one cell per lane of a SIMD register.
+  enum class AssemblyEngine
+  {
+    CellWise,
+    Batched
+  };
+
+  // Select the assembly engine (the default is cell-wise).
+  void
+  set_assembly_engine(const AssemblyEngine &engine)
+  {
+    assembly_engine = engine;
+  }
+
+  // How Dirichlet conditions are imposed: on the assembled matrix, with
+  // MatrixTools::apply_boundary_values, or through AffineConstraints while
+  // the local matrices are added to the global one. The latter assembles the
+  // whole matrix at every time step (the time-invariant part cannot be
+  // copied from the constant matrix, whose constrained columns would not be
+  // eliminated), always with the cell-wise engine, and is not available in
+  // matrix-free mode.
+  enum class DirichletMethod
+  {
+    ApplyBoundaryValues,
+    Constraints
+  };
+
+  // Select how Dirichlet conditions are imposed (the default is
+  // ApplyBoundaryValues).
+  void
+  set_dirichlet_method(const DirichletMethod &method)
+  {
+    dirichlet_method = method;
+  }
+
+  // Formulation used to compute drag and lift: integral of the stress over
+  // the obstacle faces, or residual of the momentum equation integrated over
+  // the cells around the obstacle.
+  enum class ForceMethod
+  {
+    Surface,
+    Volume
+  };
+
+  // Select how drag and lift are computed (the default is Surface). Must be
+  // called before setup().
+  void
+  set_force_method(const ForceMethod &method)
+  {
+    force_method = method;
+  }
+
+  // Number of active cells of the whole mesh.
+  types::global_cell_index
+  n_global_active_cells() const
+  {
+    return mesh.n_global_active_cells();
+  }
+
+  // Number of DoFs of the whole problem.
+  types::global_dof_index
+  n_dofs() const
+  {
+    return dof_handler.n_dofs();
+  }
+
+  // Drag and lift, and their coefficients, at each time step.
+  std::vector<double> vec_drag;
+  std::vector<double> vec_lift;
+  std::vector<double> vec_drag_coeff;
+  std::vector<double> vec_lift_coeff;
+
+  // Wall time [ms] spent at each time step in assembly, preconditioner
+  // setup, linear solve and output.
+  std::vector<double> time_assemble;
+  std::vector<double> time_prec;
+  std::vector<double> time_solve;
+  std::vector<double> time_output;
+
+  std::vector<unsigned int> gmres_iterations;
+  std::vector<bool> preconditioner_rebuilt;
+
+  // Iterations of the inner solves of the preconditioner at each time step.
+  std::vector<unsigned long long> inner_iterations;
+
+  // Time, time step and number of rejected attempts of each time step.
+  std::vector<double> time_values;
+  std::vector<double> deltat_values;
+  std::vector<unsigned int> rejected_steps;
+
+protected:
+  // Assemble the time-invariant part of the system (viscous term, time
+  // derivative and pressure coupling), and, if with_pressure_mass is true,
+  // the pressure mass matrix. Called at the end of setup(), and again
+  // (without the pressure mass, which does not depend on the time step)
+  // whenever the time step changes.
+  void
+  assemble_constant(const bool &with_pressure_mass = false);
+
+  // Call function with the block preconditioner selected by
+  // preconditioner_type (matrix-based mode only).
+  template <typename FunctionType>
+  void
+  dispatch_preconditioner(const FunctionType &function)
+  {
+    switch (preconditioner_type)
+    {
+    case PreconditionerType::BlockDiagonal:
+      function(preconditioner_block_diagonal);
+      break;
+    case PreconditionerType::BlockTriangular:
+      function(preconditioner_block_triangular);
+      break;
+    case PreconditionerType::SIMPLE:
+      function(preconditioner_simple);
+      break;
+    case PreconditionerType::aSIMPLE:
+      function(preconditioner_asimple);
+      break;
+    case PreconditionerType::PCD:
+      function(preconditioner_pcd);
+      break;
+    case PreconditionerType::LSC:
+      function(preconditioner_lsc);
+      break;
+    }
+  }
+
+  // Whether the preconditioner in use is built from the pressure mass matrix.
+  bool
+  pressure_mass_needed()
+  {
+    if (matrix_free)
+      return PreconditionaSIMPLEMatrixFree::needs_pressure_mass;
+
+    bool needed = false;
+    dispatch_preconditioner([&needed](const auto &preconditioner_)
+                            { needed = preconditioner_.needs_pressure_mass; });
+    return needed;
+  }
+
+  // Total number of inner iterations of the preconditioner in use.
+  unsigned long long
+  n_inner_iterations()
+  {
+    if (matrix_free)
+      return preconditioner_matrix_free.get_inner_iterations();
+
+    unsigned long long n = 0;
+    dispatch_preconditioner([&n](const auto &preconditioner_)
+                            { n = preconditioner_.get_inner_iterations(); });
+    return n;
+  }
+
+  // Apply the parameters declared by declare_parameters().
+  void
+  parse_parameters(ParameterHandler &prm);
+
+  // Assemble system, adding the convective term and the right-hand side to
+  // the time-invariant part.
+  void
+  assemble(const double time);
+
+  // Degrees of the element with a specialized cell kernel (P2-P1, the
+  // Taylor-Hood pair used in the benchmarks), and its number of DoFs per cell.
+  static constexpr unsigned int degree_velocity_specialized = 2;
+  static constexpr unsigned int degree_pressure_specialized = 1;
+  static constexpr int n_dofs_specialized = n_dofs_per_cell(
+      dim, degree_velocity_specialized, degree_pressure_specialized);
+
+  // Local DoFs of a cell, split into velocity DoFs (also by component) and
+  // pressure DoFs. For the specialized kernel the lists are std::arrays, so
+  // that every loop of the cell kernels has a compile-time trip count; for
+  // any other element (n_dofs_static == -1) they are vectors sized at run
+  // time.
+  template <int n_dofs_static>
+  struct LocalDoFLists
+  {
+    static_assert(n_dofs_static == -1 || n_dofs_static == n_dofs_specialized,
+                  "Only the P2-P1 element has a specialized kernel.");
+
+    static constexpr bool is_static = n_dofs_static > 0;
+
+    template <unsigned int n>
+    using List = std::conditional_t<is_static,
+                                    std::array<unsigned int, n>,
+                                    std::vector<unsigned int>>;
+
+    using ComponentList =
+        List<n_scalar_dofs_per_cell(dim, degree_velocity_specialized)>;
+    using VelocityList =
+        List<dim * n_scalar_dofs_per_cell(dim, degree_velocity_specialized)>;
+    using PressureList =
+        List<n_scalar_dofs_per_cell(dim, degree_pressure_specialized)>;
+
+    // The lists are filled from the component of each local shape function.
+    // Those of the specialized kernel are left unfilled if the element is not
+    // the one it is specialized for, since the kernel is not called then.
+    explicit LocalDoFLists(const std::vector<unsigned int> &component)
+    {
+      if (is_static &&
+          component.size() != static_cast<unsigned int>(n_dofs_specialized))
+        return;
+
+      std::vector<unsigned int> velocity_dofs;
+      std::vector<std::vector<unsigned int>> velocity_dofs_by_component(dim);
+      std::vector<unsigned int> pressure_dofs;
+      for (unsigned int i = 0; i < component.size(); ++i)
+      {
+        if (component[i] < dim)
+        {
+          velocity_dofs.push_back(i);
+          velocity_dofs_by_component[component[i]].push_back(i);
+        }
+        else
+          pressure_dofs.push_back(i);
+      }
+
+      assign(velocity, velocity_dofs);
+      for (unsigned int c = 0; c < dim; ++c)
+        assign(velocity_by_component[c], velocity_dofs_by_component[c]);
+      assign(pressure, pressure_dofs);
+    }
+
+    VelocityList velocity = {};
+    std::array<ComponentList, dim> velocity_by_component = {};
+    PressureList pressure = {};
+
+  private:
+    template <typename ListType>
+    static void
+    assign(ListType &list, const std::vector<unsigned int> &dofs)
+    {
+      if constexpr (is_static)
+      {
+        AssertDimension(dofs.size(), list.size());
+        std::copy(dofs.begin(), dofs.end(), list.begin());
+      }
+      else
+        list = dofs;
+    }
+  };
+
+  // Per-thread scratch objects used by the assembly. WorkStream creates one
+  // copy for each worker thread, so that cells can be processed concurrently.
+  struct AssemblyScratchData
+  {
+    AssemblyScratchData(const FiniteElement<dim> &fe,
+                        const Quadrature<dim> &quadrature,
+                        const Quadrature<dim - 1> &quadrature_face)
+        : fe_values(fe,
+                    quadrature,
+                    update_values | update_gradients |
+                        update_quadrature_points | update_JxW_values),
+          fe_face_values(fe,
+                         quadrature_face,
+                         update_values | update_quadrature_points |
+                             update_normal_vectors | update_JxW_values),
+          current_velocity_values(quadrature.size()),
+          forcing_term_values(quadrature.size(), Vector<double>(dim)),
+          neumann_values(quadrature_face.size(), Vector<double>(dim)),
+          component(components(fe)),
+          specialized_dof_lists(component),
+          dof_lists(component),
+          phi(fe.dofs_per_cell),
+          grad_phi(fe.dofs_per_cell),
+          convected_grad_phi(fe.dofs_per_cell)
+    {
+    }
+
+    AssemblyScratchData(const AssemblyScratchData &scratch_data)
+        : fe_values(scratch_data.fe_values.get_fe(),
+                    scratch_data.fe_values.get_quadrature(),
+                    scratch_data.fe_values.get_update_flags()),
+          fe_face_values(scratch_data.fe_face_values.get_fe(),
+                         scratch_data.fe_face_values.get_quadrature(),
+                         scratch_data.fe_face_values.get_update_flags()),
+          current_velocity_values(scratch_data.current_velocity_values.size()),
+          forcing_term_values(scratch_data.forcing_term_values),
+          neumann_values(scratch_data.neumann_values),
+          component(scratch_data.component),
+          specialized_dof_lists(scratch_data.specialized_dof_lists),
+          dof_lists(scratch_data.dof_lists),
+          phi(scratch_data.phi.size()),
+          grad_phi(scratch_data.grad_phi.size()),
+          convected_grad_phi(scratch_data.convected_grad_phi.size())
+    {
+    }
+
+    FEValues<dim> fe_values;
+    FEFaceValues<dim> fe_face_values;
+    std::vector<Tensor<1, dim>> current_velocity_values;
+
+    // Forcing term at the quadrature points of the cell, and Neumann data at
+    // those of the current face, evaluated in a single call each.
+    std::vector<Vector<double>> forcing_term_values;
+    std::vector<Vector<double>> neumann_values;
+
+    // Every shape function of the FESystem has a single nonzero component.
+    // component[i] is that component, and the local DoFs are split by
+    // component, into fixed-size lists for the specialized kernel and into
+    // lists sized at run time for the generic one.
+    std::vector<unsigned int> component;
+    LocalDoFLists<n_dofs_specialized> specialized_dof_lists;
+    LocalDoFLists<-1> dof_lists;
+
+    // Lists of the kernel for n_dofs_static DoFs per cell.
+    template <int n_dofs_static>
+    const LocalDoFLists<n_dofs_static> &
+    get_dof_lists() const
+    {
+      if constexpr (n_dofs_static > 0)
+        return specialized_dof_lists;
+      else
+        return dof_lists;
+    }
+
+    static std::vector<unsigned int>
+    components(const FiniteElement<dim> &fe)
+    {
+      std::vector<unsigned int> component(fe.dofs_per_cell);
+      for (unsigned int i = 0; i < fe.dofs_per_cell; ++i)
+        component[i] = fe.system_to_component_index(i).first;
+      return component;
+    }
+
+    // Value and gradient of the nonzero component of each shape function at
+    // the current quadrature point.
+    std::vector<double> phi;
+    std::vector<Tensor<1, dim>> grad_phi;
+
+    // w * grad(phi_j) for the velocity shape functions, with w the
+    // convective velocity at the current quadrature point.
+    std::vector<Tensor<1, dim>> convected_grad_phi;
+  };
+
+  // Local contributions of one cell, copied into the global matrices by a
+  // single thread at a time.
+  struct AssemblyCopyData
+  {
+    AssemblyCopyData(const unsigned int dofs_per_cell)
+        : cell_matrix(dofs_per_cell, dofs_per_cell),
+          cell_pressure_mass_matrix(dofs_per_cell, dofs_per_cell),
+          cell_rhs(dofs_per_cell),
+          dof_indices(dofs_per_cell)
+    {
+    }
+
+    FullMatrix<double> cell_matrix;
+    FullMatrix<double> cell_pressure_mass_matrix;
+    Vector<double> cell_rhs;
+    std::vector<types::global_dof_index> dof_indices;
+  };
+
+  // Call function with the number of DoFs per cell as a compile-time constant
+  // (a std::integral_constant<int, n>) for the elements with a specialized
+  // kernel (P2-P1, the Taylor-Hood pair used in the benchmarks), or with -1
+  // for any other element, in which case the kernels read it from the finite
+  // element at run time. Fixed loop bounds let the compiler unroll and
+  // vectorize the innermost loops of the cell kernels.
+  template <typename FunctionType>
+  void
+  dispatch_kernel(const FunctionType &function) const
+  {
+    if (degree_velocity == degree_velocity_specialized &&
+        degree_pressure == degree_pressure_specialized)
+      function(std::integral_constant<int, n_dofs_specialized>());
+    else
+      function(std::integral_constant<int, -1>());
+  }
+
+  // Compute the time-invariant local matrices of a single cell.
+  template <int n_dofs_static>
+  void
+  local_assemble_constant(const typename DoFHandler<dim>::active_cell_iterator &cell,
+                          AssemblyScratchData &scratch,
+                          AssemblyCopyData &copy_data,
+                          const bool &with_pressure_mass);
+
+  // Compute the convective local matrix and the local right-hand side of a
+  // single cell. If keep_cell_matrix is true, the convective term is added to
+  // the local matrix already in copy_data instead of overwriting it.
+  template <int n_dofs_static>
+  void
+  local_assemble_system(const typename DoFHandler<dim>::active_cell_iterator &cell,
+                        AssemblyScratchData &scratch,
+                        AssemblyCopyData &copy_data,
+                        const bool &keep_cell_matrix = false);
+
+  // Add the local matrix and right-hand side of a single cell to the global
+  // ones.
+  void
+  copy_local_to_global(const AssemblyCopyData &copy_data);
+
+  // Number of cells assembled together by the batched engine.
+  static constexpr unsigned int n_lanes = VectorizedArray<double>::size();
+
+  // Scratch data of the batched engine. The values and reference gradients
+  // of the velocity shape functions are the same on every cell, and are
+  // computed once. The data that differ between cells (inverse Jacobian, JxW,
+  // DoF values and forcing term) are stored as structures of arrays, with
+  // one cell of the batch in each lane.
+  struct BatchAssemblyScratchData
+  {
+    BatchAssemblyScratchData(const FiniteElement<dim> &fe,
+                             const Quadrature<dim> &quadrature,
+                             const Quadrature<dim - 1> &quadrature_face)
+        : fe_values(fe,
+                    quadrature,
+                    update_inverse_jacobians | update_quadrature_points |
+                        update_JxW_values),
+          fe_face_values(fe,
+                         quadrature_face,
+                         update_values | update_quadrature_points |
+                             update_JxW_values),
+          local_dof_indices(fe.dofs_per_cell),
+          forcing_term_values(quadrature.size(), Vector<double>(dim)),
+          neumann_values(quadrature_face.size(), Vector<double>(dim))
+    {
+      for (unsigned int i = 0; i < fe.dofs_per_cell; ++i)
+        if (fe.system_to_component_index(i).first < dim)
+        {
+          velocity_dofs.push_back(i);
+          component.push_back(fe.system_to_component_index(i).first);
+        }
+
+      const unsigned int n_u = velocity_dofs.size();
+      const unsigned int n_q = quadrature.size();
+
+      phi.reinit(n_u, n_q);
+      ref_grad_phi.reinit(n_u, n_q);
+      for (unsigned int k = 0; k < n_u; ++k)
+        for (unsigned int q = 0; q < n_q; ++q)
+        {
+          phi(k, q) = fe.shape_value(velocity_dofs[k], quadrature.point(q));
+          ref_grad_phi(k, q) =
+              fe.shape_grad(velocity_dofs[k], quadrature.point(q));
+        }
+
+      JxW.resize(n_q);
+      forcing_values.resize(n_q);
+      dof_values.resize(n_u);
+      convected_grad_phi.resize(n_u);
+      cell_matrix.resize(n_u * n_u);
+      cell_rhs.resize(n_u);
+    }
+
+    BatchAssemblyScratchData(const BatchAssemblyScratchData &scratch_data)
+        : fe_values(scratch_data.fe_values.get_fe(),
+                    scratch_data.fe_values.get_quadrature(),
+                    scratch_data.fe_values.get_update_flags()),
+          fe_face_values(scratch_data.fe_face_values.get_fe(),
+                         scratch_data.fe_face_values.get_quadrature(),
+                         scratch_data.fe_face_values.get_update_flags()),
+          local_dof_indices(scratch_data.local_dof_indices.size()),
+          forcing_term_values(scratch_data.forcing_term_values),
+          neumann_values(scratch_data.neumann_values),
+          velocity_dofs(scratch_data.velocity_dofs),
+          component(scratch_data.component),
+          phi(scratch_data.phi),
+          ref_grad_phi(scratch_data.ref_grad_phi),
+          JxW(scratch_data.JxW.size()),
+          forcing_values(scratch_data.forcing_values.size()),
+          dof_values(scratch_data.dof_values.size()),
+          convected_grad_phi(scratch_data.convected_grad_phi.size()),
+          cell_matrix(scratch_data.cell_matrix.size()),
+          cell_rhs(scratch_data.cell_rhs.size())
+    {
+    }
+
+    // Used one cell at a time, to fill the lanes of the batch.
+    FEValues<dim> fe_values;
+    FEFaceValues<dim> fe_face_values;
+    std::vector<types::global_dof_index> local_dof_indices;
+    std::vector<Vector<double>> forcing_term_values;
+    std::vector<Vector<double>> neumann_values;
+
+    // Local index and component of each velocity shape function.
+    std::vector<unsigned int> velocity_dofs;
+    std::vector<unsigned int> component;
+
+    // Value and reference gradient of velocity shape function k at
+    // quadrature point q.
+    Table<2, double> phi;
+    Table<2, Tensor<1, dim>> ref_grad_phi;
+
+    // Per-batch data.
+    Tensor<2, dim, VectorizedArray<double>> inverse_jacobian;
+    std::vector<VectorizedArray<double>> JxW;
+    std::vector<Tensor<1, dim, VectorizedArray<double>>> forcing_values;
+    std::vector<VectorizedArray<double>> dof_values;
+    std::vector<Tensor<1, dim, VectorizedArray<double>>> convected_grad_phi;
+
+    // Local matrix (row-major, velocity DoFs only) and right-hand side of
+    // all cells of the batch.
+    std::vector<VectorizedArray<double>> cell_matrix;
+    std::vector<VectorizedArray<double>> cell_rhs;
+  };
+
+  // Local contributions of the cells of a batch, restricted to the velocity
+  // DoFs.
+  struct BatchAssemblyCopyData
+  {
+    BatchAssemblyCopyData(const unsigned int n_velocity_dofs)
+        : n_filled_lanes(0),
+          cell_matrix(n_lanes,
+                      FullMatrix<double>(n_velocity_dofs, n_velocity_dofs)),
+          cell_rhs(n_lanes, Vector<double>(n_velocity_dofs)),
+          dof_indices(n_lanes,
+                      std::vector<types::global_dof_index>(n_velocity_dofs))
+    {
+    }
+
+    unsigned int n_filled_lanes;
+    std::vector<FullMatrix<double>> cell_matrix;
+    std::vector<Vector<double>> cell_rhs;
+    std::vector<std::vector<types::global_dof_index>> dof_indices;
+  };
+
+  // Compute the convective local matrices and the local right-hand sides of
+  // the batch of locally owned cells starting at *batch.
+  void
+  local_assemble_batch(const std::vector<unsigned int>::const_iterator &batch,
+                       BatchAssemblyScratchData &scratch,
+                       BatchAssemblyCopyData &copy_data);
+
+  // Add the local matrices and right-hand sides of a batch to the global
+  // ones.
+  void
+  copy_batch_to_global(const BatchAssemblyCopyData &copy_data);
+
+  // Find the DoFs subject to Dirichlet conditions and compute their values,
+  // and record the support points of the inlet DoFs. Called once by setup().
+  void
+  setup_boundary_values();
+
+  // Re-evaluate the values of the inlet DoFs at the given time, without
+  // walking over the boundary faces again, and rebuild the constraints.
+  void
+  update_boundary_values(const double &time);
+
+  // Solve the problem for one time step.
+  void
+  solve_time_step();
+
+  // Output results. In VTU format, the output files are written by a
+  // background task: see wait_for_output().
+  void
+  output(const unsigned int &time_step, const double &time) const;
+
+  // Wait until the output files of the last call to output() are written.
+  void
+  wait_for_output() const;
+
+  // Key identifying a DoF independently of the partitioning: its vector
+  // component, followed by the coordinates of its support point (rounded to
+  // 1e-8, so that keys computed on different processes may differ by one in
+  // a coordinate; read_checkpoint() accounts for that).
+  using CheckpointKey = std::array<long long, dim + 1>;
+
+  // Keys of the locally owned DoFs.
+  std::vector<std::pair<types::global_dof_index, CheckpointKey>>
+  checkpoint_keys() const;
+
+  // Name of the data file written by process rank for the checkpoint of the
+  // given time step.
+  std::string
+  checkpoint_data_file_name(const unsigned int &time_step,
+                            const unsigned int &rank) const;
+
+  // Write the current solution, time and history to a checkpoint.
+  void
+  write_checkpoint(const unsigned int &time_step, const double &time);
+
+  // Read the checkpoint, if it exists, returning whether it did.
+  bool
+  read_checkpoint(unsigned int &time_step, double &time);
+
+  // Largest CFL number |u| deltat p / h over the locally owned cells, with p
+  // the velocity degree, computed at the quadrature points.
+  double
+  compute_cfl() const;
+
+  // Change the time step, updating the matrices that depend on it.
+  void
+  set_time_step(const double &deltat_);
+
+  // Whether the solution must be written at the given time step, according
+  // to the output frequency (see set_output_frequency()).
+  bool
+  output_due(const unsigned int &time_step, const double &time);
+
+  // Find the locally owned faces and cells where drag and lift are
+  // computed. Called once by setup().
+  void
+  setup_force_evaluation();
+
+  // Compute lift and drag.
+  void
+  compute_forces();
+
+  // Assemble the pressure Laplacian and the pressure convection-diffusion
+  // matrix of the PCD preconditioner, with the current velocity.
+  void
+  assemble_pcd();
+
+  // Assemble the diagonal of the lumped velocity mass matrix of the LSC
+  // preconditioner.
+  void
+  assemble_lumped_velocity_mass();
+
+  // MPI parallel. /////////////////////////////////////////////////////////////
+
+  // Number of MPI processes.
+  const unsigned int mpi_size;
+
+  // This MPI process.
+  const unsigned int mpi_rank;
+
+  // Parallel output stream.
+  ConditionalOStream pcout;
+
+  // Timed sections and counters, summarized at the end of solve() (mutable,
+  // since output() is const).
+  mutable Profiler profiler;
+
+  // Problem definition. ///////////////////////////////////////////////////////
+
+  // Kinematic viscosity [m2/s].
+  double nu = 1e-3;
+
+  const double rho = 1.;
+
+  // Forcing term.
+  ForcingTerm forcing_term;
+
+  // Inlet velocity.
+  InletVelocity inlet_velocity;
+
+  // Boundary tags of the meshes (see mesh/cilinder_2D.geo and
+  // mesh/cilinder_3D.geo). Dirichlet conditions are imposed on the inlet and
+  // on the no-slip walls (in 2D, only the obstacle), and the Neumann datum
+  // function_h on all the other boundaries except the outlet.
+  const types::boundary_id inlet_id = dim == 2 ? 1 : 5;
+  const types::boundary_id outlet_id = 3;
+  const std::vector<types::boundary_id> wall_ids =
+      dim == 2 ? std::vector<types::boundary_id>{5, 6}
+               : std::vector<types::boundary_id>{1, 2, 4, 6, 7, 8, 9, 10};
+
+  // Boundary tags of the obstacle, on which drag and lift are computed.
+  const std::vector<types::boundary_id> obstacle_ids =
+      dim == 2 ? std::vector<types::boundary_id>{5, 6}
+               : std::vector<types::boundary_id>{6, 7, 8, 9};
+
+  // Discretization. ///////////////////////////////////////////////////////////
+
+  // Mesh file name.
+  const std::string mesh_file_name;
+
+  // Polynomial degree used for velocity.
+  const unsigned int degree_velocity;
+
+  // Polynomial degree used for pressure.
+  const unsigned int degree_pressure;
+  // Final time.
+  const double T;
+
+  // Tolerance of the outer solver, relative to the norm of the right-hand
+  // side, and its restart length.
+  double solver_tolerance = dim == 2 ? 1e-4 : 1e-2;
+  unsigned int gmres_restart_length = 30;
+
+  // Relative tolerance of the inner solves of the block preconditioners, and
+  // how they are stopped (see set_inner_solve()).
+  double inner_tolerance = 1e-2;
+  InnerSolveType inner_solve_type = InnerSolveType::Tolerance;
+  unsigned int inner_solve_iterations = 5;
+  double inner_tolerance_max = 0.1;
+
+  // Time step (changed during the simulation if adaptive_time_step is set).
+  double deltat;
+
+  // Adaptive time stepping (see set_adaptive_time_step()).
+  bool adaptive_time_step = false;
+  double cfl_target = 1.0;
+  double deltat_min = 0.0;
+  double deltat_max = 0.0;
+
+  // If true, the velocity-velocity block is never assembled and the linear
+  // system is solved through the matrix-free OseenOperator.
+  const bool matrix_free;
+
+  // h(x).
+  FunctionH function_h;
+
+  // Initial condition.
+  FunctionU0 u_0;
+
+  // Output frequency, in time steps.
+  unsigned int output_interval = 1;
+
+  // Output frequency, in simulated time (only used if positive).
+  double output_time_interval = 0.0;
+
+  // Next simulated time at which the solution is written.
+  double next_output_time = 0.0;
+
+  // Background task writing the output files.
+  mutable std::future<std::size_t> output_task;
+
+  // Format of the output files.
+  OutputFormat output_format = OutputFormat::VTU;
+
+  // File the mesh has been written to by this run, empty until it is written
+  // (HDF5 output only). A restarted run writes its own mesh file, since the
+  // layout of the mesh depends on the partitioning.
+  mutable std::string hdf5_mesh_file_name;
+
+  // Entries of the XDMF file, one for each output time (HDF5 output only).
+  mutable std::vector<XDMFEntry> xdmf_entries;
+
+  // Wall time between two checkpoints [s] (0 disables checkpoints).
+  double checkpoint_interval = 0.0;
+
+  // Prefix of the checkpoint files.
+  std::string checkpoint_prefix = "checkpoint";
+
+  // Whether to restart from the last checkpoint.
+  bool restart = false;
+
+  // Wall time of the last checkpoint.
+  std::chrono::steady_clock::time_point last_checkpoint_time;
+
+  // Time step and number of processes of the last complete checkpoint, whose
+  // data files are deleted once the next one is complete.
+  unsigned int last_checkpoint_step = numbers::invalid_unsigned_int;
+  unsigned int last_checkpoint_mpi_size = 0;
+
+  // Number of processes in each group sharing a reader of the mesh file (0
+  // means that all processes are in the same group).
+  unsigned int mesh_group_size = 0;
+
+  // Prefix of the files storing the partitioned mesh (empty if partitioned
+  // meshes are not saved).
+  std::string partition_file_prefix;
+
+  // Mesh.
+  parallel::fullydistributed::Triangulation<dim> mesh;
+
+  // Finite element space.
+  std::unique_ptr<FiniteElement<dim>> fe;
+
+  // Quadrature formula.
+  std::unique_ptr<Quadrature<dim>> quadrature;
+
+  // Quadrature formula for face integrals.
+  std::unique_ptr<Quadrature<dim - 1>> quadrature_face;
+
+  // DoF handler.
+  DoFHandler<dim> dof_handler;
+
+  // Locally owned cells, and the index of the first cell of each batch of
+  // the batched assembly engine.
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> locally_owned_cells;
+  std::vector<unsigned int> batch_starts;
+
+  // Engine used by assemble().
+  AssemblyEngine assembly_engine = AssemblyEngine::CellWise;
+
+  // Velocity DoF on the inlet, whose Dirichlet value is given by
+  // inlet_velocity at its support point.
+  struct InletDoF
+  {
+    types::global_dof_index index;
+    unsigned int component;
+    Point<dim> point;
+  };
+
+  // Inlet DoFs of the locally relevant cells (excluding those shared with the
+  // walls, whose value is zero).
+  std::vector<InletDoF> inlet_dofs;
+
+  // Method used to compute drag and lift.
+  ForceMethod force_method = ForceMethod::Surface;
+
+  // Locally owned obstacle faces, as (cell, face number) pairs.
+  std::vector<std::pair<typename DoFHandler<dim>::active_cell_iterator, unsigned int>>
+      obstacle_faces;
+
+  // Velocity DoFs on the obstacle, and locally owned cells having some of
+  // them (only used by the volume formulation).
+  IndexSet obstacle_dofs;
+  std::vector<typename DoFHandler<dim>::active_cell_iterator> obstacle_cells;
+
+  // Solution at the previous time step (including ghost elements), only
+  // stored for the volume formulation of the forces.
+  TrilinosWrappers::MPI::BlockVector solution_previous;
+
+  // Dirichlet values of the locally relevant constrained DoFs.
+  std::map<types::global_dof_index, double> boundary_values;
+
+  // Method used to impose the Dirichlet conditions, and the corresponding
+  // constraints (only used with DirichletMethod::Constraints).
+  DirichletMethod dirichlet_method = DirichletMethod::ApplyBoundaryValues;
+  AffineConstraints<double> dirichlet_constraints;
+
+  // DoFs owned by current process.
+  IndexSet locally_owned_dofs;
+
+  // DoFs owned by current process in the velocity and pressure blocks.
+  std::vector<IndexSet> block_owned_dofs;
+
+  // DoFs relevant to the current process (including ghost DoFs).
+  IndexSet locally_relevant_dofs;
+
+  // DoFs relevant to current process in the velocity and pressure blocks.
+  std::vector<IndexSet> block_relevant_dofs;
+
+  // System matrix. In matrix-free mode, only the pressure coupling blocks are
+  // stored.
+  TrilinosWrappers::BlockSparseMatrix system_matrix;
+
+  // Time-invariant part of the system matrix (viscous term, time derivative
+  // and pressure coupling), assembled once in setup() and copied into
+  // system_matrix at every time step.
+  TrilinosWrappers::BlockSparseMatrix constant_matrix;
+
+  // Matrix-free linearized operator (only used in matrix-free mode).
+  OseenOperator oseen_operator;
+
+  // Preconditioners, kept across time steps and rebuilt according to the
+  // refresh policy (see set_preconditioner_refresh()).
+  PreconditionerType preconditioner_type = PreconditionerType::aSIMPLE;
+  PreconditionBlockDiagonal preconditioner_block_diagonal;
+  PreconditionBlockTriangular preconditioner_block_triangular;
+  PreconditionSIMPLE preconditioner_simple;
+  PreconditionaSIMPLE preconditioner_asimple;
+  PreconditionPCD preconditioner_pcd;
+  PreconditionLSC preconditioner_lsc;
+  PreconditionaSIMPLEMatrixFree preconditioner_matrix_free;
+
+  // Preconditioner used for the inner solves of the block preconditioner.
+  InnerPreconditionerType inner_preconditioner_type = InnerPreconditionerType::ILU;
+
+  // Krylov solver of the outer iterations.
+  OuterSolverType outer_solver_type = OuterSolverType::FGMRES;
+
+  // Initial guess of the outer solver, and the solutions it is computed from.
+  InitialGuessType initial_guess_type = InitialGuessType::Previous;
+  SolutionHistory solution_history;
+
+  // Near null space of the velocity block (one constant mode per velocity
+  // component), needed by the AMG preconditioner.
+  std::vector<std::vector<bool>> velocity_constant_modes;
+
+  // Maximum number of GMRES iterations before the preconditioner is rebuilt.
+  unsigned int preconditioner_max_iterations = numbers::invalid_unsigned_int;
+
+  // Maximum number of time steps the preconditioner is used for.
+  unsigned int preconditioner_max_age = 1;
+
+  // Number of time steps since the preconditioner was last built.
+  unsigned int preconditioner_age = numbers::invalid_unsigned_int;
+
+  // Pressure mass matrix, needed by some preconditioners (see
+  // pressure_mass_needed()), and left empty otherwise. We use a block matrix
+  // for convenience, but in practice we only look at the pressure-pressure
+  // block.
+  TrilinosWrappers::BlockSparseMatrix pressure_mass;
+
+  // Pressure Laplacian and convection-diffusion matrices of the PCD
+  // preconditioner (same sparsity as the pressure mass matrix), the
+  // homogeneous Dirichlet conditions they are built with, and the vector
+  // masking the constrained DoFs (PCD only).
+  TrilinosWrappers::BlockSparseMatrix pressure_laplacian;
+  TrilinosWrappers::BlockSparseMatrix pressure_convection_diffusion;
+  AffineConstraints<double> pcd_constraints;
+  TrilinosWrappers::MPI::Vector pcd_free_pressure;
+
+  // Diagonal of the lumped velocity mass matrix (LSC only).
+  TrilinosWrappers::MPI::Vector velocity_lumped_mass;
+
+  // Right-hand side vector in the linear system.
+  TrilinosWrappers::MPI::BlockVector system_rhs;
+
+  // System solution (without ghost elements).
+  TrilinosWrappers::MPI::BlockVector solution_owned;
+
+  // System solution (including ghost elements).
+  TrilinosWrappers::MPI::BlockVector solution;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "NavierStokes.hpp"
+
+#include <numeric>
+
+// Declare the parameters of the benchmark, besides those of the solver.
+void
+declare_benchmark_parameters(ParameterHandler &prm)
+{
+  prm.enter_subsection("Benchmark");
+  {
+    prm.declare_entry("Steps", "5", Patterns::Integer(1),
+                      "Number of time steps of each case");
+    prm.declare_entry("Report file", "benchmark_report.csv",
+                      Patterns::FileName(),
+                      "CSV file the results are appended to");
+  }
+  prm.leave_subsection();
+}
+
+// Run one case for a fixed number of time steps, and append a line to the
+// report with the results normalized by the number of steps and of cells.
+template <int dim>
+void
+run_benchmark(ParameterHandler &prm, const unsigned int &n_threads)
+{
+  prm.enter_subsection("Benchmark");
+  const unsigned int n_steps = prm.get_integer("Steps");
+  const std::string report_file_name = prm.get("Report file");
+  prm.leave_subsection();
+
+  // Fixed time step, ending after n_steps steps, and no output besides the
+  // initial condition.
+  prm.set("Final time", (n_steps - 0.5) * prm.get_double("Time step"));
+  prm.enter_subsection("Time stepping");
+  prm.set("Target CFL", 0.0);
+  prm.leave_subsection();
+  prm.enter_subsection("Output");
+  prm.set("Interval steps", std::to_string(n_steps + 1));
+  prm.set("Interval time", 0.0);
+  prm.leave_subsection();
+  prm.enter_subsection("Checkpoint");
+  prm.set("Interval", 0.0);
+  prm.set("Restart", false);
+  prm.leave_subsection();
+
+  prm.enter_subsection("Linear solver");
+  const std::string preconditioner_name = prm.get("Preconditioner");
+  prm.leave_subsection();
+
+  NavierStokes<dim> problem(prm);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  problem.setup();
+  const double time_setup =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+          .count();
+
+  problem.solve();
+
+  const auto sum = [](const auto &values)
+  { return std::accumulate(values.begin(), values.end(), 0.0); };
+
+  // Times are the largest over the processes, the memory high-water mark is
+  // the largest resident set size of a process.
+  const double steps = problem.time_solve.size();
+  const double time_assemble =
+      Utilities::MPI::max(sum(problem.time_assemble), MPI_COMM_WORLD) / 1000.0;
+  const double time_prec =
+      Utilities::MPI::max(sum(problem.time_prec), MPI_COMM_WORLD) / 1000.0;
+  const double time_solve =
+      Utilities::MPI::max(sum(problem.time_solve), MPI_COMM_WORLD) / 1000.0;
+
+  Utilities::System::MemoryStats memory_stats;
+  Utilities::System::get_memory_stats(memory_stats);
+  const double memory_hwm =
+      Utilities::MPI::max(memory_stats.VmHWM / 1024.0, MPI_COMM_WORLD);
+
+  if (Utilities::MPI::this_mpi_process(MPI_COMM_WORLD) != 0)
+    return;
+
+  const bool new_report = !std::ifstream(report_file_name).good();
+  std::ofstream report(report_file_name, std::ios::app);
+
+  if (new_report)
+    report << "DIM,MESH,PRECONDITIONER,RANKS,THREADS,CELLS,DOFS,STEPS,"
+              "T_SETUP [s],ASSEMBLY [cells/s],T_PREC/STEP [s],T_SOLVE/STEP [s],"
+              "ITER/STEP,INNER_ITER/STEP,MEMORY_HWM [MB]"
+           << std::endl;
+
+  report << dim << "," << prm.get("Mesh file") << "," << preconditioner_name
+         << "," << Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD) << ","
+         << n_threads << "," << problem.n_global_active_cells() << ","
+         << problem.n_dofs() << "," << steps << "," << time_setup << ","
+         << problem.n_global_active_cells() * steps / time_assemble << ","
+         << time_prec / steps << "," << time_solve / steps << ","
+         << sum(problem.gmres_iterations) / steps << ","
+         << sum(problem.inner_iterations) / steps << "," << memory_hwm
+         << std::endl;
+}
+
+// Main function.
+int
+main(int argc, char *argv[])
+{
+  // The first argument is the dimension of the case (2 or 3). The other ones
+  // are the same as for navier_stokes2D and navier_stokes3D, with the
+  // additional parameters of the "Benchmark" subsection, e.g.
+  //   mpirun -n 4 ./navier_stokes_bench 3 "Mesh file=../mesh/cilinder_3D_fine.msh"
+  // The whole matrix of cases is run by scripts/run_benchmarks.sh.
+  AssertThrow(argc > 1 && (std::string(argv[1]) == "2" ||
+                           std::string(argv[1]) == "3"),
+              ExcMessage("The first argument must be the dimension, 2 or 3."));
+  const unsigned int dim = std::stoi(argv[1]);
+
+  ParameterHandler prm;
+  if (dim == 2)
+    NavierStokes<2>::declare_parameters(prm);
+  else
+    NavierStokes<3>::declare_parameters(prm);
+  declare_benchmark_parameters(prm);
+
+  // The dimension takes the place of the program name.
+  NavierStokes<2>::parse_command_line(prm, argc - 1, argv + 1);
+
+  const unsigned int n_threads = prm.get_integer("Threads");
+
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv, n_threads);
+
+  if (dim == 2)
+    run_benchmark<2>(prm, n_threads);
+  else
+    run_benchmark<3>(prm, n_threads);
+
+  return 0;
+}
@@ -1,24 +1,32 @@
-#include "NavierStokes2D.hpp"
+#include "NavierStokes.hpp"
 
 // Main function.
 int main(int argc, char *argv[])
 {
-  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+  // All the settings are read from an optional parameter file, given as
+  // first argument, and can be overridden by further arguments of the form
+  // "Section/Name=value", e.g.
+  //   ./navier_stokes2D navier_stokes2D.prm "Linear solver/Preconditioner=SIMPLE"
+  // See parameters/navier_stokes2D.prm for the available parameters and
+  // their defaults.
+  ParameterHandler prm;
+  NavierStokes<2>::declare_parameters(prm);
+  NavierStokes<2>::parse_command_line(prm, argc, argv);
+
+  // Number of threads used by each MPI process during assembly. With the
+  // default of one thread per process, the assembly is purely MPI-parallel.
+  const unsigned int n_threads = prm.get_integer("Threads");
+
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv, n_threads);
 
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  const std::string mesh_file_name = argc > 1 ? argv[1] : "../mesh/cilinder_2D_fine.msh";
-  const unsigned int degree_velocity = 2;
-  const unsigned int degree_pressure = 1;
-
-  const double T = 24;
-  const double deltat = 0.05;
 
   dealii::Timer timer;
   // Start the timer
   timer.restart();
 
-  NavierStokes problem(mesh_file_name, degree_velocity, degree_pressure, T, deltat);
+  NavierStokes<2> problem(prm);
 
   problem.setup();
   problem.solve();
@@ -30,27 +38,7 @@ int main(int argc, char *argv[])
   if(rank == 0)
     std::cout << "Time taken to solve ENTIRE Navier Stokes problem: " << timer.wall_time() << " seconds" << std::endl;
 
-  if (rank == 0)
-  {
-    const std::string output_filename = "forces_results_2D_2case.csv";
-    std::ofstream outputFile(output_filename);
-
-    if (!outputFile.is_open())
-    {
-      std::cerr << "Error opening output file" << std::endl;
-      return -1;
-    }
-    outputFile << "Iteration, Drag, Lift, Coeff Drag, CoeffLift, time prec, time solve" << std::endl;
-
-    for (size_t ite = 0; ite < problem.vec_drag.size(); ite++)
-    {
-      outputFile << ite * deltat << ", " << problem.vec_drag[ite] << ", " << problem.vec_lift_coeff[ite] << ", " 
-                << problem.vec_drag_coeff[ite] << ", " << problem.vec_lift_coeff[ite] << ", "
-                << problem.time_prec[ite] << ", " << problem.time_solve[ite]
-                << std::endl;
-    }
-    outputFile.close();
-  }
+  problem.output_results();
 
   return 0;
 }
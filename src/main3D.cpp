@@ -1,19 +1,26 @@
-#include "NavierStokes3D.hpp"
+#include "NavierStokes.hpp"
 
 // Main function.
 int
 main(int argc, char *argv[])
 {
-  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+  // All the settings are read from an optional parameter file, given as
+  // first argument, and can be overridden by further arguments of the form
+  // "Section/Name=value", e.g.
+  //   ./navier_stokes3D navier_stokes3D.prm "Linear solver/Preconditioner=SIMPLE"
+  // See parameters/navier_stokes3D.prm for the available parameters and
+  // their defaults.
+  ParameterHandler prm;
+  NavierStokes<3>::declare_parameters(prm);
+  NavierStokes<3>::parse_command_line(prm, argc, argv);
 
-  const std::string  mesh_file_name  = argc>1?argv[1]:"../mesh/cilinder_3D_coarse.msh";
-  const unsigned int degree_velocity = 2;
-  const unsigned int degree_pressure = 1;
+  // Number of threads used by each MPI process during assembly. With the
+  // default of one thread per process, the assembly is purely MPI-parallel.
+  const unsigned int n_threads = prm.get_integer("Threads");
 
-	const double T      = 8.0;
-	const double deltat = 0.05;
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv, n_threads);
 
-  NavierStokes problem(mesh_file_name, degree_velocity, degree_pressure, T, deltat);
+  NavierStokes<3> problem(prm);
 
   problem.setup();
   problem.solve();